@@ -0,0 +1,109 @@
+#include "browser_pool.h"
+
+#include <algorithm>
+#include <vector>
+
+BrowserPool::BrowserPool(BrowserRegistry* registry, flutter::TextureRegistrar* texture_registrar,
+                         CefRefPtr<WebviewApp> app)
+    : registry_(registry), texture_registrar_(texture_registrar), app_(app) {
+    context_initialized_callback_id_ = app_->AddContextInitializedCallback([this](bool initialized) {
+        if (!initialized) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            context_initialized_ = true;
+        }
+        Fill();
+    });
+}
+
+BrowserPool::~BrowserPool() {
+    if (context_initialized_callback_id_) {
+        app_->RemoveContextInitializedCallback(context_initialized_callback_id_);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Idle browsers belong to the engine of the pool, which is going away.
+    for (auto& handler : idle_) {
+        handler->DetachFromEngine();
+    }
+    idle_.clear();
+}
+
+void BrowserPool::SetSize(size_t size) {
+    std::vector<CefRefPtr<WebviewHandler>> closed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_ = size;
+        while (idle_.size() > size_) {
+            closed.push_back(idle_.back());
+            idle_.pop_back();
+        }
+    }
+    for (auto& handler : closed) {
+        handler->Close();
+    }
+    Fill();
+}
+
+CefRefPtr<WebviewHandler> BrowserPool::Lease(int browser_id, float dpi,
+                                             event_codec::EventEncoding event_encoding) {
+    CefRefPtr<WebviewHandler> handler;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.empty()) return nullptr;
+
+        auto it = std::find_if(idle_.begin(), idle_.end(),
+                               [](const auto& h) { return h->IsBrowserCreated(); });
+        if (it == idle_.end()) it = idle_.begin();
+        handler = *it;
+        idle_.erase(it);
+    }
+
+    if (!registry_->Add(browser_id, handler)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_front(handler);
+        return nullptr;
+    }
+    handler->Adopt(browser_id, dpi, event_encoding);
+    Fill();
+    return handler;
+}
+
+void BrowserPool::Return(CefRefPtr<WebviewHandler> handler, bool clear_history, bool clear_storage) {
+    if (clear_storage) handler->ClearStorage();
+
+    // Idle browsers all use the global context.
+    bool keep = !handler->GetRequestContext();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        keep = keep && !clear_history && idle_.size() < size_;
+    }
+    if (keep && handler->ResetForPool()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.size() < size_) {
+            idle_.push_back(handler);
+            return;
+        }
+    }
+
+    handler->Close();
+    Fill();
+}
+
+void BrowserPool::Fill() {
+    std::vector<CefRefPtr<WebviewHandler>> created;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!context_initialized_) return;
+
+        while (idle_.size() < size_) {
+            CefRefPtr<WebviewHandler> handler =
+                new WebviewHandler(registry_, texture_registrar_, WebviewHandler::kPooledBrowserID, 1.0f);
+            idle_.push_back(handler);
+            created.push_back(handler);
+        }
+    }
+    for (auto& handler : created) {
+        app_->CreateBrowser(handler);
+    }
+}
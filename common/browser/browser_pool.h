@@ -0,0 +1,57 @@
+#ifndef COMMON_BROWSER_BROWSER_POOL_H_
+#define COMMON_BROWSER_BROWSER_POOL_H_
+#pragma once
+
+#include <flutter/texture_registrar.h>
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+#include "browser_registry.h"
+#include "event_codec.h"
+#include "webview_app.h"
+#include "webview_handler.h"
+
+// Idle about:blank browsers of one Flutter engine, created ahead of time so
+// createBrowser does not wait for a browser and its renderer process to start.
+// The pool is filled once the CEF context is initialized and refilled after
+// every lease.
+class BrowserPool {
+public:
+    BrowserPool(BrowserRegistry* registry, flutter::TextureRegistrar* texture_registrar,
+                CefRefPtr<WebviewApp> app);
+    ~BrowserPool();
+
+    // Zero, the default, disables the pool. Idle browsers beyond |size| are
+    // closed.
+    void SetSize(size_t size);
+
+    // Returns an idle browser added to the registry as |browser_id|, nullptr
+    // if the pool is empty or the id is taken. Browsers that are already
+    // created are handed out first.
+    CefRefPtr<WebviewHandler> Lease(int browser_id, float dpi, event_codec::EventEncoding event_encoding);
+
+    // Takes a browser back from its controller. It goes back to the pool on
+    // about:blank if there is room, otherwise it is closed. CEF cannot clear
+    // the back/forward list, a browser whose history must go is closed and
+    // replaced by a fresh one. Browsers with a request context of their own
+    // are always closed.
+    void Return(CefRefPtr<WebviewHandler> handler, bool clear_history, bool clear_storage);
+
+private:
+    // Creates browsers until the pool is full.
+    void Fill();
+
+    BrowserRegistry* registry_;
+    flutter::TextureRegistrar* texture_registrar_;
+    CefRefPtr<WebviewApp> app_;
+    int context_initialized_callback_id_ = 0;
+
+    std::mutex mutex_;
+    bool context_initialized_ = false;
+    size_t size_ = 0;
+    std::deque<CefRefPtr<WebviewHandler>> idle_;
+};
+
+#endif  // COMMON_BROWSER_BROWSER_POOL_H_
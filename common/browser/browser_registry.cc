@@ -0,0 +1,216 @@
+#include "browser_registry.h"
+
+#include <flutter/event_stream_handler_functions.h>
+
+#include <cstring>
+#include <vector>
+
+#include "ipc.h"
+#include "webview_handler.h"
+
+namespace {
+
+const char kMethodChannelName[] = "webview_cef/browsers";
+const char kEventChannelName[] = "webview_cef/browsers/events";
+const char kPayloadChannelName[] = "webview_cef/browsers/payloads";
+
+std::mutex focused_browser_mutex_;
+CefRefPtr<CefBrowser> focused_browser_ = nullptr;
+
+}
+
+BrowserRegistry::BrowserRegistry(flutter::BinaryMessenger* messenger) : messenger_(messenger) {
+    method_channel_ = std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
+        messenger,
+        kMethodChannelName,
+        &flutter::StandardMethodCodec::GetInstance()
+    );
+    method_channel_->SetMethodCallHandler([this](const auto& call, auto result) {
+        HandleMethodCall(call, std::move(result));
+    });
+
+    event_channel_ = std::make_unique<flutter::EventChannel<flutter::EncodableValue>>(
+        messenger,
+        kEventChannelName,
+        &flutter::StandardMethodCodec::GetInstance()
+    );
+
+    auto handler = std::make_unique<flutter::StreamHandlerFunctions<flutter::EncodableValue>>(
+        [this](
+            const flutter::EncodableValue* arguments,
+            std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&&
+            events
+        ) {
+            std::lock_guard<std::mutex> lock(event_sink_mutex_);
+            event_sink_ = std::move(events);
+            return nullptr;
+        },
+        [this](const flutter::EncodableValue* arguments) {
+            std::lock_guard<std::mutex> lock(event_sink_mutex_);
+            event_sink_ = nullptr;
+            return nullptr;
+        }
+    );
+
+    event_channel_->SetStreamHandler(std::move(handler));
+}
+
+BrowserRegistry::~BrowserRegistry() {
+    method_channel_->SetMethodCallHandler(nullptr);
+    event_channel_->SetStreamHandler(nullptr);
+}
+
+bool BrowserRegistry::Add(int browser_id, CefRefPtr<WebviewHandler> handler) {
+    {
+        std::lock_guard<std::mutex> lock(browsers_mutex_);
+        if (!browsers_.emplace(browser_id, handler).second) return false;
+    }
+    MarkUsed(browser_id);
+    return true;
+}
+
+void BrowserRegistry::Remove(int browser_id) {
+    CefRefPtr<WebviewHandler> handler;
+    {
+        std::lock_guard<std::mutex> lock(browsers_mutex_);
+        const auto it = browsers_.find(browser_id);
+        if (it == browsers_.end()) return;
+        // Released outside the lock, it may be the last reference.
+        handler = it->second;
+        browsers_.erase(it);
+        recently_used_.remove(browser_id);
+    }
+}
+
+CefRefPtr<WebviewHandler> BrowserRegistry::Find(int browser_id) {
+    std::lock_guard<std::mutex> lock(browsers_mutex_);
+    const auto it = browsers_.find(browser_id);
+    return it != browsers_.end() ? it->second : nullptr;
+}
+
+std::vector<CefRefPtr<WebviewHandler>> BrowserRegistry::Browsers() {
+    std::lock_guard<std::mutex> lock(browsers_mutex_);
+    std::vector<CefRefPtr<WebviewHandler>> browsers;
+    browsers.reserve(browsers_.size());
+    for (const auto& it : browsers_) {
+        browsers.push_back(it.second);
+    }
+    return browsers;
+}
+
+void BrowserRegistry::SetLiveBrowserLimit(size_t limit) {
+    int most_recently_used;
+    {
+        std::lock_guard<std::mutex> lock(browsers_mutex_);
+        live_browser_limit_ = limit;
+        if (recently_used_.empty()) return;
+        most_recently_used = recently_used_.front();
+    }
+    MarkUsed(most_recently_used);
+}
+
+void BrowserRegistry::MarkUsed(int browser_id) {
+    std::vector<CefRefPtr<WebviewHandler>> discarded;
+    {
+        std::lock_guard<std::mutex> lock(browsers_mutex_);
+        recently_used_.remove(browser_id);
+        recently_used_.push_front(browser_id);
+        if (live_browser_limit_ == 0) return;
+
+        size_t live = 0;
+        for (const auto id : recently_used_) {
+            const auto& handler = browsers_.at(id);
+            if (handler->IsDiscarded()) continue;
+            if (++live > live_browser_limit_) discarded.push_back(handler);
+        }
+    }
+    for (auto& handler : discarded) {
+        handler->Discard();
+    }
+}
+
+void BrowserRegistry::EmitEvent(const flutter::EncodableValue& event) {
+    std::lock_guard<std::mutex> lock(event_sink_mutex_);
+    if (event_sink_) event_sink_->Success(event);
+}
+
+void BrowserRegistry::InvokeMethod(int browser_id, const std::string& method, flutter::EncodableValue arguments,
+                                   std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    auto args = std::make_unique<flutter::EncodableValue>(flutter::EncodableList{
+        flutter::EncodableValue(browser_id),
+        std::move(arguments),
+    });
+    method_channel_->InvokeMethod(method, std::move(args), std::move(result));
+}
+
+void BrowserRegistry::SendPayload(int browser_id, CefRefPtr<CefSharedMemoryRegion> region) {
+    const auto header = ipc::GetSharedMessageHeader(region);
+    if (!header) return;
+
+    const auto message_size = sizeof(ipc::SharedMessageHeader) + header->payload_size;
+    if (header->browser_id == browser_id) {
+        messenger_->Send(kPayloadChannelName, static_cast<const uint8_t*>(region->Memory()), message_size);
+        return;
+    }
+
+    // The region is read only.
+    std::unique_ptr<uint8_t[]> message(new uint8_t[message_size]);
+    std::memcpy(message.get(), header, message_size);
+    reinterpret_cast<ipc::SharedMessageHeader*>(message.get())->browser_id = browser_id;
+    messenger_->Send(kPayloadChannelName, message.get(), message_size);
+}
+
+void BrowserRegistry::HandleMethodCall(
+    const flutter::MethodCall<flutter::EncodableValue>& method_call,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    const auto method = WebviewHandler::MethodFromName(method_call.method_name());
+    if (!method) {
+        result->NotImplemented();
+        return;
+    }
+
+    const auto args = std::get_if<flutter::EncodableList>(method_call.arguments());
+    const auto browser_id = args && args->size() == 2 ? std::get_if<int32_t>(&(*args)[0]) : nullptr;
+    if (!browser_id) {
+        result->Error("InvalidArguments", "browserID");
+        return;
+    }
+
+    auto handler = Find(*browser_id);
+    if (!handler) {
+        result->Error("browser not found");
+        return;
+    }
+
+    // Any command but these marks the browser as used, and brings it back if
+    // it was discarded. The others only change settings or tear down, the
+    // view of a discarded browser goes away when its widget does.
+    if (*method != WebviewHandler::Method::Discard && *method != WebviewHandler::Method::Dispose &&
+        *method != WebviewHandler::Method::SetResourceBudget && *method != WebviewHandler::Method::SetCrashRecovery &&
+        *method != WebviewHandler::Method::SetEventSubscriptions &&
+        *method != WebviewHandler::Method::DeattachView) {
+        handler->Restore();
+        MarkUsed(*browser_id);
+    }
+    handler->HandleMethodCall(*method, &(*args)[1], std::move(result));
+}
+
+// static
+CefRefPtr<CefBrowser> BrowserRegistry::FocusedBrowser() {
+    std::lock_guard<std::mutex> lock(focused_browser_mutex_);
+    return focused_browser_;
+}
+
+// static
+void BrowserRegistry::SetFocusedBrowser(CefRefPtr<CefBrowser> browser) {
+    std::lock_guard<std::mutex> lock(focused_browser_mutex_);
+    focused_browser_ = browser;
+}
+
+// static
+void BrowserRegistry::ClearFocusedBrowser(CefRefPtr<CefBrowser> browser) {
+    std::lock_guard<std::mutex> lock(focused_browser_mutex_);
+    if (focused_browser_ && focused_browser_->IsSame(browser)) {
+        focused_browser_ = nullptr;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef COMMON_BROWSER_BROWSER_REGISTRY_H_
+#define COMMON_BROWSER_BROWSER_REGISTRY_H_
+#pragma once
+
+#include "include/cef_browser.h"
+#include "include/cef_shared_memory_region.h"
+#include <flutter/binary_messenger.h>
+#include <flutter/event_channel.h>
+#include <flutter/event_sink.h>
+#include <flutter/method_channel.h>
+#include <flutter/standard_method_codec.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class WebviewHandler;
+
+// The browsers created from one Flutter engine, keyed by browser id. Commands
+// for all of them arrive on a single method channel as [browserID, arguments]
+// and their events leave on a single event channel.
+class BrowserRegistry {
+public:
+    explicit BrowserRegistry(flutter::BinaryMessenger* messenger);
+    ~BrowserRegistry();
+
+    // Returns false if |browser_id| is already taken.
+    bool Add(int browser_id, CefRefPtr<WebviewHandler> handler);
+    void Remove(int browser_id);
+    CefRefPtr<WebviewHandler> Find(int browser_id);
+    std::vector<CefRefPtr<WebviewHandler>> Browsers();
+
+    // Keeps at most |limit| browsers alive, the least recently used ones
+    // beyond it are discarded and restored by their next command. Zero, the
+    // default, keeps them all.
+    void SetLiveBrowserLimit(size_t limit);
+
+    // Sends an event built with event_codec, it already carries the browser id.
+    void EmitEvent(const flutter::EncodableValue& event);
+    // Calls |method| on the Dart side with [browser_id, arguments].
+    void InvokeMethod(int browser_id, const std::string& method, flutter::EncodableValue arguments,
+                      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result = nullptr);
+
+    // Sends a shared memory message of the renderer of |browser_id| on the
+    // payload channel. Used for large results which would otherwise be
+    // converted into an EncodableValue and encoded. The renderer already
+    // wrote the ipc::SharedMessageHeader Dart reads, so the region goes out
+    // as it is and the messenger makes the only copy. A header written before
+    // the renderer learned the current browser id is fixed in a copy.
+    void SendPayload(int browser_id, CefRefPtr<CefSharedMemoryRegion> region);
+
+    // Keyboard and IME input goes to one browser of the process, whichever
+    // engine created it.
+    static CefRefPtr<CefBrowser> FocusedBrowser();
+    static void SetFocusedBrowser(CefRefPtr<CefBrowser> browser);
+    // Clears the focused browser if it is |browser|.
+    static void ClearFocusedBrowser(CefRefPtr<CefBrowser> browser);
+
+private:
+    void HandleMethodCall(
+        const flutter::MethodCall<flutter::EncodableValue>& method_call,
+        std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+    flutter::BinaryMessenger* messenger_;
+    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> method_channel_;
+    std::unique_ptr<flutter::EventChannel<flutter::EncodableValue>> event_channel_;
+
+    // Moves |browser_id| to the front of the recently used browsers and
+    // discards the browsers beyond the live browser limit.
+    void MarkUsed(int browser_id);
+
+    std::mutex browsers_mutex_;
+    std::unordered_map<int, CefRefPtr<WebviewHandler>> browsers_;
+    // Browser ids, the most recently used first.
+    std::list<int> recently_used_;
+    size_t live_browser_limit_ = 0;
+
+    // Events are emitted from the CEF UI thread.
+    std::mutex event_sink_mutex_;
+    std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> event_sink_;
+};
+
+#endif  // COMMON_BROWSER_BROWSER_REGISTRY_H_
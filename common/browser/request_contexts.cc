@@ -0,0 +1,37 @@
+#include "request_contexts.h"
+
+#include <map>
+#include <mutex>
+
+#include "include/cef_request_context_handler.h"
+
+namespace
+{
+    std::mutex contexts_mutex;
+    std::map<std::string, CefRefPtr<CefRequestContext>> contexts;
+
+    CefRefPtr<CefRequestContext> Create(const request_contexts::Options& options) {
+        CefRequestContextSettings settings;
+        CefString(&settings.cache_path) = options.cache_path;
+        return CefRequestContext::CreateContext(settings, nullptr);
+    }
+}
+
+namespace request_contexts
+{
+
+CefRefPtr<CefRequestContext> Get(const Options& options) {
+    if (options.name.empty()) return Create(options);
+
+    std::lock_guard<std::mutex> lock(contexts_mutex);
+    auto& context = contexts[options.name];
+    if (!context) context = Create(options);
+    return context;
+}
+
+void Clear() {
+    std::lock_guard<std::mutex> lock(contexts_mutex);
+    contexts.clear();
+}
+
+} // namespace request_contexts
@@ -0,0 +1,34 @@
+#ifndef COMMON_BROWSER_REQUEST_CONTEXTS_H_
+#define COMMON_BROWSER_REQUEST_CONTEXTS_H_
+#pragma once
+
+#include <string>
+
+#include "include/cef_request_context.h"
+
+// Request contexts browsers can use instead of the global one. They are shared
+// by every engine of the process, like the CEF runtime.
+namespace request_contexts
+{
+
+struct Options {
+    // Browsers asking for the same name share the context, and its cache and
+    // storage. The options of the first browser of a name win. An empty name
+    // gives the browser a context of its own, which goes away with it.
+    std::string name;
+    // Absolute path under CefSettings.root_cache_path. Empty keeps the cache
+    // and the storage in memory.
+    std::string cache_path;
+};
+
+// Creates the context of |options| or returns the existing one of its name.
+// May be called on any thread once CEF is initialized.
+CefRefPtr<CefRequestContext> Get(const Options& options);
+
+// Drops the named contexts. Called on the CEF thread before CefShutdown,
+// which expects every context to be released.
+void Clear();
+
+} // namespace request_contexts
+
+#endif  // COMMON_BROWSER_REQUEST_CONTEXTS_H_
@@ -0,0 +1,156 @@
+#include "resource_sampler.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "include/base/cef_callback.h"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#include "webview_handler.h"
+
+namespace {
+
+const char* TaskTypeName(cef_task_type_t type) {
+    switch (type) {
+    case CEF_TASK_TYPE_BROWSER: return "browser";
+    case CEF_TASK_TYPE_GPU: return "gpu";
+    case CEF_TASK_TYPE_ZYGOTE: return "zygote";
+    case CEF_TASK_TYPE_UTILITY: return "utility";
+    case CEF_TASK_TYPE_RENDERER: return "renderer";
+    case CEF_TASK_TYPE_EXTENSION: return "extension";
+    case CEF_TASK_TYPE_GUEST: return "guest";
+    case CEF_TASK_TYPE_PLUGIN: return "plugin";
+    case CEF_TASK_TYPE_SANDBOX_HELPER: return "sandboxHelper";
+    case CEF_TASK_TYPE_DEDICATED_WORKER: return "dedicatedWorker";
+    case CEF_TASK_TYPE_SHARED_WORKER: return "sharedWorker";
+    case CEF_TASK_TYPE_SERVICE_WORKER: return "serviceWorker";
+    default: return "unknown";
+    }
+}
+
+}  // namespace
+
+ResourceSampler::ResourceSampler(BrowserRegistry* registry) : registry_(registry) {}
+
+void ResourceSampler::SetInterval(int interval_ms) {
+    int generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation = ++generation_;
+        interval_ms_ = interval_ms;
+        if (interval_ms_ <= 0) {
+            snapshot_.clear();
+            group_snapshot_.clear();
+        }
+    }
+    if (interval_ms > 0) {
+        CefPostTask(TID_UI, base::BindOnce(&ResourceSampler::Sample, this, generation));
+    }
+}
+
+void ResourceSampler::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+        interval_ms_ = 0;
+    }
+    // Samples starting from now on see the new generation.
+    std::lock_guard<std::mutex> lock(sample_mutex_);
+}
+
+flutter::EncodableList ResourceSampler::GetSnapshot() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return snapshot_;
+}
+
+flutter::EncodableMap ResourceSampler::GetGroupSnapshot() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return group_snapshot_;
+}
+
+void ResourceSampler::Sample(int generation) {
+    std::lock_guard<std::mutex> sample_lock(sample_mutex_);
+    int interval_ms;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != generation_) return;
+        interval_ms = interval_ms_;
+    }
+
+    // Keeps trying on the next tick rather than stopping for good.
+    CefRefPtr<CefTaskManager> task_manager = CefTaskManager::GetTaskManager();
+    if (!task_manager) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != generation_) return;
+        CefPostDelayedTask(TID_UI, base::BindOnce(&ResourceSampler::Sample, this, generation), interval_ms);
+        return;
+    }
+
+    // The renderer process of a browser may be shared with others, in which
+    // case each of them reports the whole process.
+    std::map<int64_t, flutter::EncodableList> browser_ids;
+    struct Group {
+        std::set<int64_t> task_ids;
+        int64_t memory = 0;
+        double cpu_usage = 0;
+        flutter::EncodableList browser_ids;
+    };
+    std::map<std::string, Group> groups;
+    for (auto& handler : registry_->Browsers()) {
+        const int64_t task_id = handler->GetTaskId(task_manager);
+        CefTaskInfo info;
+        if (task_id < 0 || !task_manager->GetTaskInfo(task_id, info)) continue;
+
+        handler->OnResourceUsage(info.memory, info.cpu_usage);
+        browser_ids[task_id].push_back(flutter::EncodableValue(handler->browser_id()));
+
+        // Unnamed contexts would otherwise be merged into the global one.
+        if (handler->GetRequestContext() && handler->GetRequestContextName().empty()) continue;
+        auto& group = groups[handler->GetRequestContextName()];
+        group.browser_ids.push_back(flutter::EncodableValue(handler->browser_id()));
+        if (group.task_ids.insert(task_id).second) {
+            if (info.memory > 0) group.memory += info.memory;
+            group.cpu_usage += info.cpu_usage;
+        }
+    }
+
+    flutter::EncodableMap group_snapshot;
+    for (auto& [name, group] : groups) {
+        group_snapshot[flutter::EncodableValue(name)] = flutter::EncodableValue(flutter::EncodableMap{
+            {flutter::EncodableValue("memory"), flutter::EncodableValue(group.memory)},
+            {flutter::EncodableValue("cpuUsage"), flutter::EncodableValue(group.cpu_usage)},
+            {flutter::EncodableValue("processCount"), flutter::EncodableValue(static_cast<int32_t>(group.task_ids.size()))},
+            {flutter::EncodableValue("browserIDs"), flutter::EncodableValue(std::move(group.browser_ids))},
+        });
+    }
+
+    CefTaskManager::TaskIdList task_ids;
+    task_manager->GetTaskIdsList(task_ids);
+
+    flutter::EncodableList snapshot;
+    snapshot.reserve(task_ids.size());
+    for (const auto task_id : task_ids) {
+        CefTaskInfo info;
+        if (!task_manager->GetTaskInfo(task_id, info)) continue;
+
+        const auto it = browser_ids.find(task_id);
+        snapshot.push_back(flutter::EncodableValue(flutter::EncodableMap{
+            {flutter::EncodableValue("type"), flutter::EncodableValue(TaskTypeName(info.type))},
+            {flutter::EncodableValue("title"), flutter::EncodableValue(CefString(&info.title).ToString())},
+            {flutter::EncodableValue("memory"), flutter::EncodableValue(info.memory)},
+            {flutter::EncodableValue("gpuMemory"), flutter::EncodableValue(info.gpu_memory)},
+            {flutter::EncodableValue("cpuUsage"), flutter::EncodableValue(info.cpu_usage)},
+            {flutter::EncodableValue("browserIDs"),
+             flutter::EncodableValue(it != browser_ids.end() ? it->second : flutter::EncodableList())},
+        }));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (generation != generation_) return;
+    snapshot_ = std::move(snapshot);
+    group_snapshot_ = std::move(group_snapshot);
+    CefPostDelayedTask(TID_UI, base::BindOnce(&ResourceSampler::Sample, this, generation), interval_ms);
+}
@@ -0,0 +1,57 @@
+#ifndef COMMON_BROWSER_RESOURCE_SAMPLER_H_
+#define COMMON_BROWSER_RESOURCE_SAMPLER_H_
+#pragma once
+
+#include <flutter/standard_method_codec.h>
+
+#include <mutex>
+
+#include "include/cef_base.h"
+#include "include/cef_task_manager.h"
+
+#include "browser_registry.h"
+
+// Samples the CEF task manager periodically on the UI thread. Each browser of
+// the registry gets the memory and CPU usage of its renderer process, see
+// WebviewHandler::OnResourceUsage, and the last sample of every task is kept
+// for getResourceUsage.
+class ResourceSampler : public virtual CefBaseRefCounted {
+public:
+    explicit ResourceSampler(BrowserRegistry* registry);
+
+    // Zero, the default, stops sampling.
+    void SetInterval(int interval_ms);
+    // Stops sampling and waits for a sample in progress, the registry may be
+    // destroyed once it returns.
+    void Stop();
+
+    // List of {type, title, memory, gpuMemory, cpuUsage, browserIDs} maps, one
+    // per task of the last sample.
+    flutter::EncodableList GetSnapshot();
+
+    // {memory, cpuUsage, processCount, browserIDs} maps of the last sample by
+    // process group, the request context name of the browsers. The "" group
+    // is the global context. A browser with an unnamed context is a group of
+    // its own and left out, its usage is that of its task. Each renderer
+    // process is counted once per group.
+    flutter::EncodableMap GetGroupSnapshot();
+
+private:
+    void Sample(int generation);
+
+    BrowserRegistry* registry_;
+
+    // Held by Sample while it runs, which makes Stop wait for it.
+    std::mutex sample_mutex_;
+    std::mutex mutex_;
+    // Bumped on every SetInterval and Stop, pending samples of an older
+    // generation do nothing.
+    int generation_ = 0;
+    int interval_ms_ = 0;
+    flutter::EncodableList snapshot_;
+    flutter::EncodableMap group_snapshot_;
+
+    IMPLEMENT_REFCOUNTING(ResourceSampler);
+};
+
+#endif  // COMMON_BROWSER_RESOURCE_SAMPLER_H_
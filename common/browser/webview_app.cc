@@ -5,14 +5,22 @@
 #include "webview_app.h"
 #include "webview_handler.h"
 
+#include <algorithm>
+#include <condition_variable>
 #include <string>
+#include <vector>
 
+#include "include/base/cef_callback.h"
 #include "include/cef_browser.h"
 #include "include/cef_command_line.h"
+#include "include/cef_task.h"
 #include "include/views/cef_browser_view.h"
 #include "include/views/cef_window.h"
+#include "include/wrapper/cef_closure_task.h"
 #include "include/wrapper/cef_helpers.h"
 
+#include "startup_timeline.h"
+
 namespace {
 
 // When using the Views framework this object provides the delegate
@@ -75,27 +83,122 @@ private:
     DISALLOW_COPY_AND_ASSIGN(SimpleBrowserViewDelegate);
 };
 
+std::mutex live_browsers_mutex;
+std::condition_variable live_browsers_closed;
+std::vector<CefRefPtr<CefBrowser>> live_browsers;
+
+void ForceCloseAllBrowsers() {
+    CEF_REQUIRE_UI_THREAD();
+    std::vector<CefRefPtr<CefBrowser>> browsers;
+    {
+        std::lock_guard<std::mutex> lock(live_browsers_mutex);
+        browsers = live_browsers;
+    }
+    for (auto& browser : browsers) {
+        browser->GetHost()->CloseBrowser(true);
+    }
+}
+
 }  // namespace
 
-WebviewApp::WebviewApp(std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> plugin_channel)
-    : plugin_channel_(std::move(plugin_channel)) {}
+WebviewApp::WebviewApp() {}
+
+void WebviewApp::SetProcessModel(int renderer_process_limit, bool process_per_site, bool relaxed_site_isolation) {
+    renderer_process_limit_ = renderer_process_limit;
+    process_per_site_ = process_per_site;
+    relaxed_site_isolation_ = relaxed_site_isolation;
+}
+
+void WebviewApp::AppendProcessModelSwitches(CefRefPtr<CefCommandLine> command_line) {
+    if (renderer_process_limit_ > 0) {
+        command_line->AppendSwitchWithValue("renderer-process-limit", std::to_string(renderer_process_limit_));
+    }
+    if (process_per_site_) command_line->AppendSwitch("process-per-site");
+    if (relaxed_site_isolation_) command_line->AppendSwitch("disable-site-isolation-trials");
+}
+
+// static
+void WebviewApp::OnBrowserCreated(CefRefPtr<CefBrowser> browser) {
+    std::lock_guard<std::mutex> lock(live_browsers_mutex);
+    live_browsers.push_back(browser);
+}
+
+// static
+void WebviewApp::OnBrowserClosed(CefRefPtr<CefBrowser> browser) {
+    {
+        std::lock_guard<std::mutex> lock(live_browsers_mutex);
+        live_browsers.erase(std::remove_if(live_browsers.begin(), live_browsers.end(),
+                                           [&](const auto& b) { return b->IsSame(browser); }),
+                            live_browsers.end());
+        if (!live_browsers.empty()) return;
+    }
+    live_browsers_closed.notify_all();
+}
+
+// static
+bool WebviewApp::CloseAllBrowsers(std::chrono::steady_clock::time_point deadline) {
+    {
+        std::lock_guard<std::mutex> lock(live_browsers_mutex);
+        if (live_browsers.empty()) return true;
+    }
+    if (!CefPostTask(TID_UI, base::BindOnce(&ForceCloseAllBrowsers))) return false;
+
+    std::unique_lock<std::mutex> lock(live_browsers_mutex);
+    return live_browsers_closed.wait_until(lock, deadline, [] { return live_browsers.empty(); });
+}
 
 void WebviewApp::OnContextInitialized() {
     CEF_REQUIRE_UI_THREAD();
-    plugin_channel_->InvokeMethod("onCEFInitialized", nullptr);
+    startup_timeline::Record(startup_timeline::Milestone::ContextInitialized);
+    // Held while running the callbacks so an engine being torn down cannot
+    // remove its callback halfway through.
+    std::lock_guard<std::mutex> lock(context_initialized_mutex_);
+    context_initialized_ = true;
+    for (auto& it : context_initialized_callbacks_) {
+        it.second(true);
+    }
+    context_initialized_callbacks_.clear();
 }
 
-void WebviewApp::CreateBrowser(CefRefPtr<WebviewHandler> handler) {
+void WebviewApp::OnStartFailed(bool permanent) {
+    std::lock_guard<std::mutex> lock(context_initialized_mutex_);
+    start_failed_ = permanent;
+    for (auto& it : context_initialized_callbacks_) {
+        it.second(false);
+    }
+    if (permanent) context_initialized_callbacks_.clear();
+}
+
+int WebviewApp::AddContextInitializedCallback(std::function<void(bool initialized)> callback) {
+    bool initialized;
+    {
+        std::lock_guard<std::mutex> lock(context_initialized_mutex_);
+        if (!context_initialized_ && !start_failed_) {
+            const auto id = ++next_callback_id_;
+            context_initialized_callbacks_[id] = std::move(callback);
+            return id;
+        }
+        initialized = context_initialized_;
+    }
+    callback(initialized);
+    return 0;
+}
+
+void WebviewApp::RemoveContextInitializedCallback(int id) {
+    std::lock_guard<std::mutex> lock(context_initialized_mutex_);
+    context_initialized_callbacks_.erase(id);
+}
+
+// static
+void WebviewApp::CreateBrowser(CefRefPtr<WebviewHandler> handler, const std::string& url) {
     // Specify CEF browser settings here.
     CefBrowserSettings browser_settings;
     browser_settings.windowless_frame_rate = 60;
 
-    std::string url = "about:blank";
-
     CefWindowInfo window_info;
     window_info.SetAsWindowless(nullptr);
     CefBrowserHost::CreateBrowser(window_info, handler, url, browser_settings,
-                                nullptr, nullptr);
+                                handler->CreateExtraInfo(), handler->GetRequestContext());
 }
 
 CefRefPtr<CefClient> WebviewApp::GetDefaultClient() {
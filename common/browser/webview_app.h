@@ -7,13 +7,18 @@
 #pragma once
 
 #include "include/cef_app.h"
+#include <chrono>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <string>
 #include "webview_handler.h"
 
 // Implement application-level callbacks for the browser process.
 class WebviewApp : public CefApp, public CefBrowserProcessHandler {
 public:
-    WebviewApp(std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> plugin_channel);
+    // One instance is shared by every Flutter engine of the process.
+    WebviewApp();
 
     // CefApp methods:
     CefRefPtr<CefBrowserProcessHandler> GetBrowserProcessHandler() override {
@@ -25,20 +30,60 @@ public:
                                             // command_line->AppendSwitch("disable-web-security");
                                             command_line->AppendSwitch("disable-gpu");
                                             command_line->AppendSwitch("disable-gpu-compositing");
+                                            if (process_type.empty()) AppendProcessModelSwitches(command_line);
                                             #ifdef __APPLE__
                                                 command_line->AppendSwitch("use-mock-keychain");
                                                 command_line->AppendSwitch("single-process");
                                             #endif
                                        }
     
+    // How browsers share renderer processes, set before CEF is initialized.
+    // Zero leaves the renderer process limit to Chromium. Same-site browsers
+    // of one request context share a process with |process_per_site|,
+    // |relaxed_site_isolation| lets cross-site frames share their parent's
+    // process at the cost of Spectre isolation between them.
+    void SetProcessModel(int renderer_process_limit, bool process_per_site, bool relaxed_site_isolation);
+
     // CefBrowserProcessHandler methods:
     void OnContextInitialized() override;
     CefRefPtr<CefClient> GetDefaultClient() override;
 
-    void WebviewApp::CreateBrowser(CefRefPtr<WebviewHandler> handler);
+    // Creates a windowless browser for |handler| on |url|, in the request
+    // context of the handler.
+    static void CreateBrowser(CefRefPtr<WebviewHandler> handler, const std::string& url = "about:blank");
+
+    // Every browser of the process, popups included, from OnAfterCreated to
+    // OnBeforeClose. Only called on the CEF UI thread.
+    static void OnBrowserCreated(CefRefPtr<CefBrowser> browser);
+    static void OnBrowserClosed(CefRefPtr<CefBrowser> browser);
+    // Force closes every browser at once on the UI thread and waits for
+    // their OnBeforeClose until |deadline|. Returns false if some are still
+    // open. Must not be called on the UI thread.
+    static bool CloseAllBrowsers(std::chrono::steady_clock::time_point deadline);
+
+    // Runs |callback| with true once the CEF context is initialized, right
+    // away on the calling thread if it already is. A failed start runs it
+    // with false, it then stays registered for the next start unless CEF can
+    // no longer be started. Returns an id for RemoveContextInitializedCallback,
+    // 0 if the callback already ran for good.
+    int AddContextInitializedCallback(std::function<void(bool initialized)> callback);
+    void RemoveContextInitializedCallback(int id);
+    // Called on the thread that failed to start CEF. |permanent| if CEF cannot
+    // be started again in this process, i.e. CefInitialize failed.
+    void OnStartFailed(bool permanent);
 
 private:
-    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> plugin_channel_;
+    void AppendProcessModelSwitches(CefRefPtr<CefCommandLine> command_line);
+
+    int renderer_process_limit_ = 0;
+    bool process_per_site_ = false;
+    bool relaxed_site_isolation_ = false;
+
+    std::mutex context_initialized_mutex_;
+    bool context_initialized_ = false;
+    bool start_failed_ = false;
+    int next_callback_id_ = 0;
+    std::map<int, std::function<void(bool initialized)>> context_initialized_callbacks_;
     // Include the default reference counting implementation.
     IMPLEMENT_REFCOUNTING(WebviewApp);
     DISALLOW_COPY_AND_ASSIGN(WebviewApp);
@@ -4,14 +4,15 @@
 
 #include "webview_handler.h"
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <iostream>
 #include <optional>
+#include <unordered_map>
 #include <flutter/method_channel.h>
 #include <flutter/method_result_functions.h>
 #include <flutter/standard_method_codec.h>
-#include <flutter/event_stream_handler_functions.h>
 
 #include "include/base/cef_callback.h"
 #include "include/cef_app.h"
@@ -22,15 +23,14 @@
 #include "include/wrapper/cef_helpers.h"
 #include "include/wrapper/cef_message_router.h"
 
+#include "startup_timeline.h"
+#include "webview_app.h"
 #include "texture_handler.h"
 #include "util.h"
 #include "message.h"
 
 namespace {
 
-// The only browser that currently get focused
-CefRefPtr<CefBrowser> current_focused_browser_ = nullptr;
-
 // Returns a data: URI with the specified contents.
 std::string GetDataURI(const std::string& data, const std::string& mime_type) {
     return "data:" + mime_type + ";base64," +
@@ -70,6 +70,23 @@ const std::optional<std::tuple<double, double, double, double, double>> GetPoint
     return std::make_tuple(*dpi, *w, *h, *x, *y);
 }
 
+// Reads the URL of the current navigation entry, which unlike the URL of the
+// main frame stays the requested one on error pages.
+class CurrentEntryVisitor : public CefNavigationEntryVisitor {
+public:
+    explicit CurrentEntryVisitor(std::string* url) : url_(url) {}
+
+    bool Visit(CefRefPtr<CefNavigationEntry> entry, bool current, int index, int total) override {
+        if (current) *url_ = entry->GetURL().ToString();
+        return true;
+    }
+
+private:
+    std::string* url_;
+
+    IMPLEMENT_REFCOUNTING(CurrentEntryVisitor);
+};
+
 int LogicalToDevice(int value, float device_scale_factor) {
     float scaled_val = static_cast<float>(value) * device_scale_factor;
     return static_cast<int>(std::floor(scaled_val));
@@ -84,9 +101,12 @@ CefRect LogicalToDevice(const CefRect& value, float device_scale_factor, int off
 
 class MessageHandler : public CefMessageRouterBrowserSide::Handler {
 public:
-    typedef std::function<void (const CefString& request)> OnQueryCallback;
+    typedef std::function<void (int64_t query_id, const CefString& request, bool persistent,
+                                CefRefPtr<Callback> callback)> OnQueryCallback;
+    typedef std::function<void (int64_t query_id)> OnQueryCanceledCallback;
 
-	explicit MessageHandler(OnQueryCallback cb) : onQueryCallback_(cb) {};
+	MessageHandler(OnQueryCallback on_query, OnQueryCanceledCallback on_query_canceled)
+        : onQueryCallback_(on_query), onQueryCanceledCallback_(on_query_canceled) {};
 
 	bool OnQuery(CefRefPtr<CefBrowser> browser,
 				 CefRefPtr<CefFrame> frame,
@@ -95,17 +115,48 @@ public:
 				 bool persistent,
 				 CefRefPtr<Callback> callback) override {
 
-        if (this->onQueryCallback_) this->onQueryCallback_(request);
-		callback->Success("");
+        this->onQueryCallback_(query_id, request, persistent, callback);
 		return true;
 	}
 
+	void OnQueryCanceled(CefRefPtr<CefBrowser> browser,
+						 CefRefPtr<CefFrame> frame,
+						 int64_t query_id) override {
+        this->onQueryCanceledCallback_(query_id);
+	}
+
 private:
     OnQueryCallback onQueryCallback_;
+    OnQueryCanceledCallback onQueryCanceledCallback_;
 
 	DISALLOW_COPY_AND_ASSIGN(MessageHandler);
 };
 
+const std::optional<int64_t> GetInt64FromMap(const flutter::EncodableMap* m, const char* key) {
+    const auto it = m->find(flutter::EncodableValue(key));
+    if (it == m->end()) return std::nullopt;
+    if (const auto v = std::get_if<int32_t>(&it->second)) return *v;
+    if (const auto v = std::get_if<int64_t>(&it->second)) return *v;
+    return std::nullopt;
+}
+
+const char* TerminationStatusName(cef_termination_status_t status) {
+    switch (status) {
+    case TS_ABNORMAL_TERMINATION: return "abnormalTermination";
+    case TS_PROCESS_WAS_KILLED: return "killed";
+    case TS_PROCESS_CRASHED: return "crashed";
+    case TS_PROCESS_OOM: return "oom";
+    case TS_LAUNCH_FAILED: return "launchFailed";
+    case TS_INTEGRITY_FAILURE: return "integrityFailure";
+    default: return "unknown";
+    }
+}
+
+constexpr std::chrono::milliseconds kCrashRecoveryInitialDelay(500);
+constexpr std::chrono::milliseconds kCrashRecoveryMaxDelay(30000);
+constexpr std::chrono::seconds kCrashRecoveryStablePeriod(60);
+constexpr int kCrashRecoveryMaxAttempts = 5;
+
 class CustomPdfPrintCallback : public CefPdfPrintCallback {
     private:
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> _result;
@@ -122,46 +173,13 @@ class CustomPdfPrintCallback : public CefPdfPrintCallback {
 
 }
 
-const CefRefPtr<CefBrowser> WebviewHandler::CurrentFocusedBrowser() {
-    return current_focused_browser_;
-}
-
-WebviewHandler::WebviewHandler(flutter::BinaryMessenger* messenger, int browser_id, float dpi) {
-    const auto browser_id_str = std::to_string(browser_id);
-    const auto method_channel_name = "webview_cef/" + browser_id_str;
-    dpi_ = dpi;
-    browser_channel_ = std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
-        messenger,
-        method_channel_name,
-        &flutter::StandardMethodCodec::GetInstance()
-    );
-    browser_channel_->SetMethodCallHandler([this](const auto& call, auto result) {
-        HandleMethodCall(call, std::move(result));
-    });
-
-    const auto event_channel_name = "webview_cef/" + browser_id_str + "/events";
-    event_channel_ = std::make_unique<flutter::EventChannel<flutter::EncodableValue>>(
-        messenger,
-        event_channel_name,
-        &flutter::StandardMethodCodec::GetInstance()
-    );
-
-    auto handler = std::make_unique<flutter::StreamHandlerFunctions<flutter::EncodableValue>>(
-        [this](
-            const flutter::EncodableValue* arguments,
-            std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&&
-            events
-        ) {
-            event_sink_ = std::move(events);
-            return nullptr;
-        },
-        [this](const flutter::EncodableValue* arguments) {
-            return nullptr;
-        }
-    );
-
-    event_channel_->SetStreamHandler(std::move(handler));
-}
+WebviewHandler::WebviewHandler(BrowserRegistry* registry, flutter::TextureRegistrar* texture_registrar,
+                               int browser_id, float dpi, event_codec::EventEncoding event_encoding)
+    : dpi_(dpi),
+      registry_(registry),
+      texture_registrar_(texture_registrar),
+      browser_id_(browser_id),
+      event_encoding_(event_encoding) {}
 
 WebviewHandler::~WebviewHandler() {}
 
@@ -169,21 +187,131 @@ void WebviewHandler::Focus() {
     if (this->is_focused_) return;
     this->is_focused_ = true;
     this->browser_->GetHost()->SetFocus(true);
-    current_focused_browser_ = this->browser_;
+    BrowserRegistry::SetFocusedBrowser(this->browser_);
 }
 
 void WebviewHandler::Unfocus() {
     if (!this->is_focused_) return;
     this->is_focused_ = false;
     this->browser_->GetHost()->SetFocus(false);
-    if (current_focused_browser_ && current_focused_browser_->IsSame(this->browser_)) {
-        current_focused_browser_ = nullptr;
+    BrowserRegistry::ClearFocusedBrowser(this->browser_);
+}
+
+void WebviewHandler::SetEventSubscriptions(const flutter::EncodableMap& subscriptions) {
+    std::lock_guard<std::mutex> lock(event_subscriptions_mutex_);
+
+    for (auto& subscription : event_subscriptions_) {
+        subscription.subscribed = false;
+    }
+
+    for (const auto& [key, value] : subscriptions) {
+        const auto name = std::get_if<std::string>(&key);
+        const auto type = name ? event_codec::EventTypeFromName(*name) : std::nullopt;
+        if (!type || static_cast<size_t>(*type) >= event_codec::kSubscribableEventCount) continue;
+
+        // Events which stay subscribed keep their throttling state.
+        auto& subscription = event_subscriptions_[static_cast<size_t>(*type)];
+        subscription.subscribed = true;
+        subscription.min_interval = std::chrono::milliseconds(0);
+        const auto max_per_second = std::get_if<int32_t>(&value);
+        if (max_per_second && *max_per_second > 0) {
+            subscription.min_interval = std::chrono::milliseconds(1000 / *max_per_second);
+        }
+    }
+
+    for (auto& subscription : event_subscriptions_) {
+        if (!subscription.subscribed) subscription.pending_event.reset();
+    }
+    has_event_subscriptions_ = true;
+}
+
+bool WebviewHandler::IsEventSubscribed(event_codec::EventType type) {
+    const auto index = static_cast<size_t>(type);
+    if (index >= event_codec::kSubscribableEventCount) return true;
+
+    std::lock_guard<std::mutex> lock(event_subscriptions_mutex_);
+    return !has_event_subscriptions_ || event_subscriptions_[index].subscribed;
+}
+
+bool WebviewHandler::ConsumeEventBudget(event_codec::EventType type, const flutter::EncodableValue& event) {
+    const auto index = static_cast<size_t>(type);
+    if (index >= event_codec::kSubscribableEventCount) return true;
+
+    std::lock_guard<std::mutex> lock(event_subscriptions_mutex_);
+    auto& subscription = event_subscriptions_[index];
+    if (subscription.min_interval.count() == 0) return true;
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - subscription.last_emitted);
+    if (!subscription.pending_event && elapsed >= subscription.min_interval) {
+        subscription.last_emitted = now;
+        return true;
+    }
+
+    // Only the latest event is kept, so the final state always reaches Dart.
+    if (!subscription.pending_event) {
+        const auto delay = subscription.min_interval - elapsed;
+        CefPostDelayedTask(TID_UI, base::BindOnce(&WebviewHandler::FlushThrottledEvent, this, type),
+                           std::max<int64_t>(delay.count(), 0));
+    }
+    subscription.pending_event = event;
+    return false;
+}
+
+void WebviewHandler::FlushThrottledEvent(event_codec::EventType type) {
+    std::optional<flutter::EncodableValue> event;
+    {
+        std::lock_guard<std::mutex> lock(event_subscriptions_mutex_);
+        auto& subscription = event_subscriptions_[static_cast<size_t>(type)];
+        if (!subscription.pending_event) return;
+
+        event.swap(subscription.pending_event);
+        subscription.last_emitted = std::chrono::steady_clock::now();
+    }
+
+    WithRegistry([&](BrowserRegistry* registry) {
+        registry->EmitEvent(*event);
+    });
+}
+
+void WebviewHandler::EmitEncodedEvent(event_codec::EventType type, const flutter::EncodableValue& event) {
+    if (ConsumeEventBudget(type, event)) {
+        WithRegistry([&](BrowserRegistry* registry) {
+            registry->EmitEvent(event);
+        });
     }
 }
 
+void WebviewHandler::SetNavigationState(const NavigationState& state) {
+    if (state == navigation_state_) return;
+
+    navigation_state_ = state;
+    EmitEvent(event_codec::EventType::NavigationStateChanged, flutter::EncodableList{
+        flutter::EncodableValue(state.url),
+        flutter::EncodableValue(state.title),
+        flutter::EncodableValue(state.can_go_back),
+        flutter::EncodableValue(state.can_go_forward),
+        flutter::EncodableValue(state.is_loading),
+        flutter::EncodableValue(state.zoom_level),
+    });
+}
+
+void WebviewHandler::RefreshZoomLevel() {
+    CEF_REQUIRE_UI_THREAD();
+    if (!this->browser_) return;
+
+    auto state = navigation_state_;
+    state.zoom_level = this->browser_->GetHost()->GetZoomLevel();
+    SetNavigationState(state);
+}
+
 void WebviewHandler::OnTitleChange(CefRefPtr<CefBrowser> browser, const CefString& title) {
     if (browser->IsPopup()) return;
-    EmitEvent(kEventTitleChanged, title.ToString());
+    EmitEvent(event_codec::EventType::TitleChanged, title.ToString());
+
+    auto state = navigation_state_;
+    state.title = title.ToString();
+    SetNavigationState(state);
 }
 
 void WebviewHandler::OnAddressChange(CefRefPtr<CefBrowser> browser,
@@ -191,7 +319,11 @@ void WebviewHandler::OnAddressChange(CefRefPtr<CefBrowser> browser,
                                     const CefString& url) {
     if (browser->IsPopup()) return;
     if (frame->IsMain()) {
-        EmitEvent(kEventURLChanged, url.ToString());
+        EmitEvent(event_codec::EventType::URLChanged, url.ToString());
+
+        auto state = navigation_state_;
+        state.url = url.ToString();
+        SetNavigationState(state);
     }
 }
 
@@ -201,14 +333,20 @@ bool WebviewHandler::OnCursorChange(CefRefPtr<CefBrowser> browser,
                                 const CefCursorInfo& custom_cursor_info) {
     if (browser->IsPopup()) return false;
 
-    EmitEvent(kEventCursorChanged, static_cast<int32_t>(type));
+    if (!IsEventSubscribed(event_codec::EventType::CursorChanged)) return false;
+
+    EmitEncodedEvent(event_codec::EventType::CursorChanged,
+                     event_codec::EncodeCursorChanged(event_encoding_, browser_id_, static_cast<int32_t>(type)));
     return false;
 }
 
 void WebviewHandler::OnLoadingProgressChange(CefRefPtr<CefBrowser> browser,
                                             double progress) {
     if (browser->IsPopup()) return;
-    EmitEvent(kEventLoadingProgressChanged, progress);
+    if (!IsEventSubscribed(event_codec::EventType::LoadingProgressChanged)) return;
+
+    EmitEncodedEvent(event_codec::EventType::LoadingProgressChanged,
+                     event_codec::EncodeLoadingProgressChanged(event_encoding_, browser_id_, progress));
 }
 
 void WebviewHandler::OnLoadingStateChange(CefRefPtr<CefBrowser> browser,
@@ -216,7 +354,15 @@ void WebviewHandler::OnLoadingStateChange(CefRefPtr<CefBrowser> browser,
                                           bool canGoBack,
                                           bool canGoForward) {
     if (browser->IsPopup()) return;
-    EmitEvent(kEventLoadingStateChanged, isLoading);
+    EmitEvent(event_codec::EventType::LoadingStateChanged, isLoading);
+
+    // The zoom level is remembered per origin, so it may change on navigation.
+    auto state = navigation_state_;
+    state.is_loading = isLoading;
+    state.can_go_back = canGoBack;
+    state.can_go_forward = canGoForward;
+    state.zoom_level = browser->GetHost()->GetZoomLevel();
+    SetNavigationState(state);
 }
 
 void WebviewHandler::OnLoadStart(CefRefPtr<CefBrowser> browser,
@@ -224,7 +370,7 @@ void WebviewHandler::OnLoadStart(CefRefPtr<CefBrowser> browser,
                             TransitionType transition_type) {
     if (browser->IsPopup()) return;
     if (frame->IsMain()) {
-        EmitEvent(kEventLoadStart, frame->GetURL().ToString());
+        EmitEvent(event_codec::EventType::LoadStart, frame->GetURL().ToString());
     }
 }
 
@@ -233,34 +379,311 @@ void WebviewHandler::OnLoadEnd(CefRefPtr<CefBrowser> browser,
                         int httpStatusCode) {
     if (browser->IsPopup()) return;
     if (frame->IsMain()) {
-        EmitEvent(kEventLoadEnd, static_cast<int32_t>(httpStatusCode));
+        if (pending_scroll_offset_) {
+            std::ostringstream script;
+            script << "window.scrollTo(" << pending_scroll_offset_->first << ", " << pending_scroll_offset_->second << ");";
+            frame->ExecuteJavaScript(script.str(), frame->GetURL(), 0);
+            pending_scroll_offset_.reset();
+        }
+        if (pending_zoom_level_) {
+            browser->GetHost()->SetZoomLevel(*pending_zoom_level_);
+            CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::RefreshZoomLevel, this));
+            pending_zoom_level_.reset();
+        }
+        EmitEvent(event_codec::EventType::LoadEnd, static_cast<int32_t>(httpStatusCode));
     }
 }
 
 void WebviewHandler::OnAfterCreated(CefRefPtr<CefBrowser> browser) {
     CEF_REQUIRE_UI_THREAD();
 
+    WebviewApp::OnBrowserCreated(browser);
     if (browser->IsPopup()) return;
 
     this->browser_ = browser;
-    this->browser_channel_->InvokeMethod("onBrowserCreated", nullptr);
+    startup_timeline::Record(startup_timeline::Milestone::FirstBrowserCreated);
 
     // Create the browser-side router for query handling.
     CefMessageRouterConfig config;
     this->message_router_ = CefMessageRouterBrowserSide::Create(config);
 
     // Register handlers with the router.
-    this->message_handler_.reset(new MessageHandler([this](const CefString& request) {
-        auto args = std::make_unique<flutter::EncodableValue>(flutter::EncodableValue(request.ToString()));
-        this->browser_channel_->InvokeMethod("onCefQuery", std::move(args));
-    }));
+    this->message_handler_.reset(new MessageHandler(
+        [this](int64_t query_id, const CefString& request, bool persistent,
+               CefRefPtr<CefMessageRouterBrowserSide::Handler::Callback> callback) {
+            this->OnCefQuery(query_id, request, persistent, callback);
+        },
+        [this](int64_t query_id) {
+            bool canceled;
+            {
+                std::lock_guard<std::mutex> lock(pending_queries_mutex_);
+                canceled = pending_queries_.erase(query_id) > 0;
+            }
+            if (canceled) {
+                WithRegistry([&](BrowserRegistry* registry) {
+                    registry->InvokeMethod(browser_id_, "onCefQueryCanceled", flutter::EncodableValue(query_id));
+                });
+            }
+        }));
     this->message_router_->AddHandler(message_handler_.get(), false);
+
+    int browser_id;
+    bool restored;
+    std::vector<DeferredCall> deferred_calls;
+    {
+        std::lock_guard<std::mutex> lock(lifecycle_mutex_);
+        if (close_on_created_) {
+            browser->GetHost()->CloseBrowser(true);
+            return;
+        }
+        browser_created_ = true;
+        browser_id = browser_id_;
+        restored = restoring_;
+        if (restored) {
+            discarded_ = restoring_ = false;
+            deferred_calls.swap(deferred_calls_);
+        }
+    }
+    if (restored) {
+        WithRegistry([&](BrowserRegistry* registry) {
+            registry->InvokeMethod(browser_id, "onBrowserRestored", flutter::EncodableValue());
+        });
+        for (auto& call : deferred_calls) {
+            this->HandleMethodCall(call.method, &call.arguments, std::move(call.result));
+        }
+    } else if (browser_id != kPooledBrowserID) {
+        WithRegistry([&](BrowserRegistry* registry) {
+            registry->InvokeMethod(browser_id, "onBrowserCreated", flutter::EncodableValue());
+        });
+    }
+}
+
+void WebviewHandler::Adopt(int browser_id, float dpi, event_codec::EventEncoding event_encoding) {
+    this->dpi_ = dpi;
+    this->event_encoding_ = event_encoding;
+
+    bool created;
+    {
+        std::lock_guard<std::mutex> lock(lifecycle_mutex_);
+        browser_id_ = browser_id;
+        created = browser_created_;
+    }
+    if (created) {
+        this->SendControllerID(this->browser_->GetMainFrame());
+        WithRegistry([&](BrowserRegistry* registry) {
+            registry->InvokeMethod(browser_id, "onBrowserCreated", flutter::EncodableValue());
+        });
+    }
+}
+
+bool WebviewHandler::ResetForPool() {
+    if (!IsBrowserCreated()) return false;
+
+    this->FailPendingCalls(async_channel_message::kErrorBrowserClosed, false);
+    WithRegistry([&](BrowserRegistry* registry) {
+        registry->Remove(browser_id_.exchange(kPooledBrowserID));
+    });
+    this->Unfocus();
+    this->DeattachView();
+
+    this->FailPendingQueries(async_channel_message::kErrorBrowserClosed);
+    {
+        std::lock_guard<std::mutex> lock(page_messages_mutex_);
+        pending_page_messages_.clear();
+    }
+
+    // The renderer keeps the scripts of the browser until it is told
+    // otherwise, the next controller must not inherit them.
+    auto frame = this->browser_->GetMainFrame();
+    {
+        std::lock_guard<std::mutex> lock(user_scripts_mutex_);
+        for (const auto& it : user_scripts_) {
+            auto msg = CefProcessMessage::Create(ipc::RemoveUserScript);
+            msg->GetArgumentList()->SetInt(ipc::indexUserScriptID, it.first);
+            frame->SendProcessMessage(PID_RENDERER, msg);
+        }
+        user_scripts_.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(registered_scripts_mutex_);
+        for (const auto& it : registered_scripts_) {
+            frame->SendProcessMessage(PID_RENDERER, async_channel_message::InvokeScript::CreateUnregisterMessage(it.first));
+        }
+        registered_scripts_.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(event_subscriptions_mutex_);
+        has_event_subscriptions_ = false;
+        event_subscriptions_.fill(EventSubscription());
+    }
+
+    this->loadUrl("about:blank");
+    return true;
+}
+
+void WebviewHandler::ClearStorage() {
+    if (!CefCurrentlyOn(TID_UI)) {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::ClearStorage, this));
+        return;
+    }
+    if (!this->browser_) return;
+
+    CefURLParts parts;
+    if (!CefParseURL(this->browser_->GetMainFrame()->GetURL(), parts)) return;
+    const auto scheme = CefString(&parts.scheme).ToString();
+    if (scheme != "http" && scheme != "https") return;
+
+    auto origin = scheme + "://" + CefString(&parts.host).ToString();
+    const auto port = CefString(&parts.port).ToString();
+    if (!port.empty()) origin += ":" + port;
+
+    CefRefPtr<CefDictionaryValue> params = CefDictionaryValue::Create();
+    params->SetString("origin", origin);
+    params->SetString("storageTypes", "all");
+    this->browser_->GetHost()->ExecuteDevToolsMethod(0, "Storage.clearDataForOrigin", params);
+}
+
+bool WebviewHandler::IsBrowserCreated() {
+    std::lock_guard<std::mutex> lock(lifecycle_mutex_);
+    return browser_created_;
+}
+
+void WebviewHandler::Discard() {
+    if (!CefCurrentlyOn(TID_UI)) {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::Discard, this));
+        return;
+    }
+    if (!this->browser_) return;
+
+    // CEF cannot rebuild the back/forward list, the new browser starts with
+    // the current entry.
+    std::string url = this->browser_->GetMainFrame()->GetURL();
+    this->browser_->GetHost()->GetNavigationEntries(new CurrentEntryVisitor(&url), true);
+
+    this->Unfocus();
+    auto browser = this->browser_;
+    {
+        std::lock_guard<std::mutex> lock(lifecycle_mutex_);
+        discarded_ = true;
+        browser_created_ = false;
+        discarded_url_ = url.empty() ? "about:blank" : url;
+    }
+    pending_scroll_offset_ = scroll_offset_;
+
+    // DoClose ignores the closing browser, it is no longer browser_.
+    this->browser_ = nullptr;
+    this->FailPendingCalls(async_channel_message::kErrorBrowserClosed, false);
+    this->FailPendingQueries(async_channel_message::kErrorBrowserClosed);
+    this->message_router_->RemoveHandler(message_handler_.get());
+    this->message_handler_.reset();
+    this->message_router_ = nullptr;
+    browser->GetHost()->CloseBrowser(true);
+
+    WithRegistry([&](BrowserRegistry* registry) {
+        registry->InvokeMethod(browser_id_, "onBrowserDiscarded", flutter::EncodableValue());
+    });
+}
+
+void WebviewHandler::Restore() {
+    std::string url;
+    {
+        std::lock_guard<std::mutex> lock(lifecycle_mutex_);
+        if (!discarded_ || restoring_) return;
+        restoring_ = true;
+        url = discarded_url_;
+    }
+    WebviewApp::CreateBrowser(this, url);
+}
+
+bool WebviewHandler::IsDiscarded() {
+    std::lock_guard<std::mutex> lock(lifecycle_mutex_);
+    return discarded_ && !restoring_;
+}
+
+int64_t WebviewHandler::GetTaskId(CefRefPtr<CefTaskManager> task_manager) {
+    if (!this->browser_) return -1;
+    return task_manager->GetTaskIdForBrowserId(this->browser_->GetIdentifier());
+}
+
+void WebviewHandler::OnResourceUsage(int64_t memory, double cpu_usage) {
+    const auto memory_budget = memory_budget_.load();
+    const auto cpu_budget = cpu_budget_.load();
+    const bool over_budget = (memory_budget > 0 && memory > memory_budget) || (cpu_budget > 0 && cpu_usage > cpu_budget);
+    const bool exceeded = over_budget && !over_budget_;
+    over_budget_ = over_budget;
+
+    if (!exceeded && !IsEventSubscribed(event_codec::EventType::ResourceUsage)) return;
+
+    const flutter::EncodableMap usage = {
+        {flutter::EncodableValue("memory"), flutter::EncodableValue(memory)},
+        {flutter::EncodableValue("cpuUsage"), flutter::EncodableValue(cpu_usage)},
+    };
+    if (exceeded) {
+        WithRegistry([&](BrowserRegistry* registry) {
+            registry->InvokeMethod(browser_id_, "onResourceBudgetExceeded", flutter::EncodableValue(usage));
+        });
+    }
+    EmitEvent(event_codec::EventType::ResourceUsage, usage);
+}
+
+void WebviewHandler::Close() {
+    bool discarded;
+    {
+        std::lock_guard<std::mutex> lock(lifecycle_mutex_);
+        discarded = discarded_ && !restoring_;
+        if (discarded) {
+            discarded_ = false;
+        } else if (!browser_created_) {
+            close_on_created_ = true;
+            return;
+        }
+    }
+    if (discarded) {
+        // There is no browser left to close.
+        this->DeattachView();
+        CefRefPtr<WebviewHandler> self(this);
+        WithRegistry([&](BrowserRegistry* registry) {
+            registry->Remove(browser_id_);
+        });
+        return;
+    }
+    this->browser_->GetHost()->CloseBrowser(true);
+}
+
+void WebviewHandler::DetachFromEngine() {
+    std::shared_ptr<TextureHandler> texture;
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex_);
+        registry_ = nullptr;
+        texture_registrar_ = nullptr;
+        this->onPaintCallback = nullptr;
+        texture.swap(this->texture_handler);
+    }
+    // Unregistered while the registrar still exists.
+    texture.reset();
+
+    // Answered, as failures, while the engine still exists.
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> dispose_result;
+    std::vector<DeferredCall> deferred_calls;
+    {
+        std::lock_guard<std::mutex> lock(lifecycle_mutex_);
+        dispose_result = std::move(dispose_result_);
+        deferred_calls.swap(deferred_calls_);
+    }
+    if (dispose_result) dispose_result->Error(async_channel_message::kErrorBrowserClosed);
+    for (auto& call : deferred_calls) {
+        call.result->Error(async_channel_message::kErrorBrowserClosed);
+    }
+
+    this->Close();
 }
 
-// Returns texture_id
+// Returns texture_id, 0 once the engine is gone.
 int64_t WebviewHandler::AttachView() {
+    std::lock_guard<std::mutex> lock(engine_mutex_);
+    if (!texture_registrar_) return 0;
     if (!this->onPaintCallback) {
-        this->texture_handler.reset(new TextureHandler());
+        this->texture_handler.reset(new TextureHandler(texture_registrar_));
         this->onPaintCallback = [this](const void* buffer, int32_t width, int32_t height) {
             this->texture_handler->onPaintCallback(buffer, width, height);
         };
@@ -269,8 +692,12 @@ int64_t WebviewHandler::AttachView() {
 }
 
 void WebviewHandler::DeattachView() {
-    this->onPaintCallback = nullptr;
-    this->texture_handler.reset();
+    std::shared_ptr<TextureHandler> texture;
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex_);
+        this->onPaintCallback = nullptr;
+        texture.swap(this->texture_handler);
+    }
 }
 
 void WebviewHandler::Invalidate() {
@@ -283,22 +710,46 @@ bool WebviewHandler::DoClose(CefRefPtr<CefBrowser> browser) {
     if (browser->IsPopup()) {
         return false;
     }
+    if (!this->browser_ || !this->browser_->IsSame(browser)) {
+        // A discarded browser.
+        return false;
+    }
 
-    this->browser_channel_->SetMethodCallHandler(nullptr);
-    this->browser_channel_ = nullptr;
     this->browser_ = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(lifecycle_mutex_);
+        browser_created_ = false;
+    }
+    this->FailPendingCalls(async_channel_message::kErrorBrowserClosed, false);
 
     this->message_router_->RemoveHandler(message_handler_.get());
     this->message_handler_.reset();
     this->message_router_ = nullptr;
-    this->texture_handler.reset();
+    this->DeattachView();
 
     if (this->onBrowserClose) this->onBrowserClose();
+    const int browser_id = browser_id_;
+    if (browser_id != kPooledBrowserID) {
+        // The registry may hold the last reference.
+        CefRefPtr<WebviewHandler> self(this);
+        WithRegistry([&](BrowserRegistry* registry) {
+            registry->Remove(browser_id);
+        });
+    }
     return false;
 }
 
 void WebviewHandler::OnBeforeClose(CefRefPtr<CefBrowser> browser) {
-    // CEF_REQUIRE_UI_THREAD();
+    CEF_REQUIRE_UI_THREAD();
+
+    WebviewApp::OnBrowserClosed(browser);
+
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> dispose_result;
+    {
+        std::lock_guard<std::mutex> lock(lifecycle_mutex_);
+        dispose_result = std::move(dispose_result_);
+    }
+    if (dispose_result) dispose_result->Success();
 }
 
 // bool WebviewHandler::OnBeforePopup(CefRefPtr<CefBrowser> browser,
@@ -331,8 +782,8 @@ void WebviewHandler::OnLoadError(CefRefPtr<CefBrowser> browser,
     if (errorCode == ERR_ABORTED)
         return;
 
-    if (frame->IsMain()) {
-        EmitEvent(kEventLoadError, flutter::EncodableMap{
+    if (frame->IsMain() && IsEventSubscribed(event_codec::EventType::LoadError)) {
+        EmitEvent(event_codec::EventType::LoadError, flutter::EncodableMap{
             {flutter::EncodableValue("errorCode"), flutter::EncodableValue(static_cast<int32_t>(errorCode))},
             {flutter::EncodableValue("errorText"), flutter::EncodableValue(errorText.ToString())},
             {flutter::EncodableValue("failedUrl"), flutter::EncodableValue(failedUrl.ToString())},
@@ -343,12 +794,11 @@ void WebviewHandler::OnLoadError(CefRefPtr<CefBrowser> browser,
 void WebviewHandler::CloseAllBrowsers(bool force_close) {
     if (!CefCurrentlyOn(TID_UI)) {
         // Execute on the UI thread.
-        //    CefPostTask(TID_UI, base::BindOnce(&SimpleHandler::CloseAllBrowsers, this,
-        //                                       force_close));
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::CloseAllBrowsers, this, force_close));
         return;
     }
 
-    this->browser_->GetHost()->CloseBrowser(force_close);
+    if (this->browser_) this->browser_->GetHost()->CloseBrowser(force_close);
 }
 
 // static
@@ -436,10 +886,11 @@ bool WebviewHandler::StartDragging(CefRefPtr<CefBrowser> browser,
 void WebviewHandler::OnScrollOffsetChanged(CefRefPtr<CefBrowser> browser,
                                         double x,
                                         double y) {
-    EmitEvent(kEventScrollOffsetChanged, flutter::EncodableMap{
-        {flutter::EncodableValue("x"), flutter::EncodableValue(x)},
-        {flutter::EncodableValue("y"), flutter::EncodableValue(y)},
-    });
+    scroll_offset_ = {x, y};
+    if (!IsEventSubscribed(event_codec::EventType::ScrollOffsetChanged)) return;
+
+    EmitEncodedEvent(event_codec::EventType::ScrollOffsetChanged,
+                     event_codec::EncodeScrollOffsetChanged(event_encoding_, browser_id_, x, y));
 }
 
 void WebviewHandler::OnImeCompositionRangeChanged(CefRefPtr<CefBrowser> browser,
@@ -451,10 +902,14 @@ void WebviewHandler::OnImeCompositionRangeChanged(CefRefPtr<CefBrowser> browser,
         auto firstCharacter = character_bounds.front();
         if (firstCharacter != _prevIMEPosition) {
             _prevIMEPosition = firstCharacter;
-            EmitEvent(kEventIMEComposionPositionChanged, flutter::EncodableMap{
-                {flutter::EncodableValue("x"), flutter::EncodableValue(static_cast<int32_t>(firstCharacter.x))},
-                {flutter::EncodableValue("y"), flutter::EncodableValue(static_cast<int32_t>(firstCharacter.y + firstCharacter.height))},
-            });
+            if (!IsEventSubscribed(event_codec::EventType::IMEComposionPositionChanged)) return;
+
+            EmitEncodedEvent(event_codec::EventType::IMEComposionPositionChanged,
+                             event_codec::EncodeIMEComposionPositionChanged(
+                                 event_encoding_,
+                                 browser_id_,
+                                 static_cast<int32_t>(firstCharacter.x),
+                                 static_cast<int32_t>(firstCharacter.y + firstCharacter.height)));
         }
     }
 }
@@ -539,28 +994,252 @@ bool WebviewHandler::GetScreenInfo(CefRefPtr<CefBrowser> browser, CefScreenInfo&
 
 void WebviewHandler::OnPaint(CefRefPtr<CefBrowser> browser, CefRenderHandler::PaintElementType type,
                             const CefRenderHandler::RectList &dirtyRects, const void *buffer, int w, int h) {
+    startup_timeline::Record(startup_timeline::Milestone::FirstPaint);
+    std::lock_guard<std::mutex> lock(engine_mutex_);
     if (this->onPaintCallback) this->onPaintCallback(buffer, w, h);
 }
 
+std::optional<WebviewHandler::Method> WebviewHandler::MethodFromName(const std::string& name) {
+    static const std::unordered_map<std::string, Method> methods = {
+        {"setEventSubscriptions", Method::SetEventSubscriptions},
+        {"loadUrl", Method::LoadUrl},
+        {"setSize", Method::SetSize},
+        {"cursorClickDown", Method::CursorClickDown},
+        {"cursorClickUp", Method::CursorClickUp},
+        {"cursorMove", Method::CursorMove},
+        {"cursorDragging", Method::CursorDragging},
+        {"setScrollDelta", Method::SetScrollDelta},
+        {"setZoomLevel", Method::SetZoomLevel},
+        {"getZoomLevel", Method::GetZoomLevel},
+        {"unfocus", Method::Unfocus},
+        {"focus", Method::Focus},
+        {"goForward", Method::GoForward},
+        {"canGoForward", Method::CanGoForward},
+        {"goBack", Method::GoBack},
+        {"canGoBack", Method::CanGoBack},
+        {"stopLoad", Method::StopLoad},
+        {"reload", Method::Reload},
+        {"openDevTools", Method::OpenDevTools},
+        {"evaluateJavaScript", Method::EvaluateJavaScript},
+        {"evaluateJavaScriptBatch", Method::EvaluateJavaScriptBatch},
+        {"cancelPendingCalls", Method::CancelPendingCalls},
+        {"postMessageToPage", Method::PostMessageToPage},
+        {"cefQueryRespond", Method::CefQueryRespond},
+        {"cefQueryFail", Method::CefQueryFail},
+        {"addUserScript", Method::AddUserScript},
+        {"removeUserScript", Method::RemoveUserScript},
+        {"registerScript", Method::RegisterScript},
+        {"unregisterScript", Method::UnregisterScript},
+        {"invokeScript", Method::InvokeScript},
+        {"setResourceBudget", Method::SetResourceBudget},
+        {"setCrashRecovery", Method::SetCrashRecovery},
+        {"printToPDF", Method::PrintToPDF},
+        {"attachView", Method::AttachView},
+        {"deattachView", Method::DeattachView},
+        {"invalidate", Method::Invalidate},
+        {"discard", Method::Discard},
+        {"dispose", Method::Dispose},
+    };
+
+    const auto it = methods.find(name);
+    if (it == methods.end()) return std::nullopt;
+    return it->second;
+}
+
 void WebviewHandler::HandleMethodCall(
-		const flutter::MethodCall<flutter::EncodableValue>& method_call,
-		std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+    Method method,
+    const flutter::EncodableValue* arguments,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+
+    // Subscriptions are accepted before the browser is ready, so the first
+    // events of the page are already filtered.
+    if (method == Method::SetEventSubscriptions) {
+        const auto subscriptions = std::get_if<flutter::EncodableMap>(arguments);
+        if (!subscriptions) {
+            result->Error(kErrorInvalidArguments);
+            return;
+        }
+
+        this->SetEventSubscriptions(*subscriptions);
+        result->Success();
+        return;
+    }
+
+    // Pending queries outlive neither the browser nor the router, answers for
+    // queries that are gone report false.
+    if (method == Method::CefQueryRespond || method == Method::CefQueryFail) {
+        const auto m = std::get_if<flutter::EncodableMap>(arguments);
+        const auto query_id = m ? GetInt64FromMap(m, "queryID") : std::nullopt;
+        if (!query_id) {
+            result->Error(kErrorInvalidArguments);
+            return;
+        }
+
+        if (method == Method::CefQueryRespond) {
+            const auto response = util::GetStringFromMap(m, "response");
+            result->Success(flutter::EncodableValue(this->RespondQuery(*query_id, response.value_or(""))));
+        } else {
+            const auto error_code = util::GetIntFromMap(m, "errorCode");
+            const auto error_message = util::GetStringFromMap(m, "errorMessage");
+            result->Success(flutter::EncodableValue(
+                this->FailQuery(*query_id, error_code.value_or(-1), error_message.value_or(""))));
+        }
+        return;
+    }
+
+    // User scripts can be added before the browser is ready as well, they
+    // reach the renderer with the first render view.
+    if (method == Method::AddUserScript) {
+        const auto m = std::get_if<flutter::EncodableMap>(arguments);
+        const auto source = m ? util::GetStringFromMap(m, "source") : std::nullopt;
+        if (!source || source->empty()) {
+            result->Error(kErrorInvalidArguments);
+            return;
+        }
+
+        const auto injection_time = util::GetIntFromMap(m, "injectionTime").value_or(0);
+        UserScript script{
+            *source,
+            injection_time == static_cast<int>(ipc::UserScriptInjectionTime::DOMContentLoaded) ?
+                ipc::UserScriptInjectionTime::DOMContentLoaded : ipc::UserScriptInjectionTime::DocumentStart,
+            util::GetBoolFromMap(m, "allFrames").value_or(false),
+        };
+        int id;
+        {
+            std::lock_guard<std::mutex> lock(user_scripts_mutex_);
+            id = ++next_user_script_id_;
+            user_scripts_[id] = script;
+        }
+        if (this->browser_) {
+            this->browser_->GetMainFrame()->SendProcessMessage(PID_RENDERER, CreateAddUserScriptMessage(id, script));
+        }
+        result->Success(flutter::EncodableValue(id));
+        return;
+    }
+    if (method == Method::RemoveUserScript) {
+        const auto id = std::get_if<int32_t>(arguments);
+        if (!id) {
+            result->Error(kErrorInvalidArguments);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(user_scripts_mutex_);
+            user_scripts_.erase(*id);
+        }
+        if (this->browser_) {
+            auto msg = CefProcessMessage::Create(ipc::RemoveUserScript);
+            msg->GetArgumentList()->SetInt(ipc::indexUserScriptID, *id);
+            this->browser_->GetMainFrame()->SendProcessMessage(PID_RENDERER, msg);
+        }
+        result->Success();
+        return;
+    }
+
+    // Scripts can be registered before the browser is ready, they are sent
+    // with the first render view.
+    if (method == Method::RegisterScript) {
+        const auto source = std::get_if<std::string>(arguments);
+        if (!source || source->empty()) {
+            result->Error(kErrorInvalidArguments);
+            return;
+        }
+
+        int handle;
+        {
+            std::lock_guard<std::mutex> lock(registered_scripts_mutex_);
+            handle = ++next_script_handle_;
+            registered_scripts_[handle] = *source;
+        }
+        if (this->browser_) {
+            this->browser_->GetMainFrame()->SendProcessMessage(
+                PID_RENDERER, async_channel_message::InvokeScript::CreateRegisterMessage(handle, *source));
+        }
+        result->Success(flutter::EncodableValue(handle));
+        return;
+    }
+    if (method == Method::UnregisterScript) {
+        const auto handle = std::get_if<int32_t>(arguments);
+        if (!handle) {
+            result->Error(kErrorInvalidArguments);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(registered_scripts_mutex_);
+            registered_scripts_.erase(*handle);
+        }
+        if (this->browser_) {
+            this->browser_->GetMainFrame()->SendProcessMessage(
+                PID_RENDERER, async_channel_message::InvokeScript::CreateUnregisterMessage(*handle));
+        }
+        result->Success();
+        return;
+    }
+
+    if (method == Method::SetResourceBudget) {
+        const auto m = std::get_if<flutter::EncodableMap>(arguments);
+        if (!m) {
+            result->Error(kErrorInvalidArguments);
+            return;
+        }
+
+        const auto cpu_usage = m->find(flutter::EncodableValue("cpuUsage"));
+        const auto cpu_budget = cpu_usage != m->end() ? std::get_if<double>(&cpu_usage->second) : nullptr;
+        memory_budget_ = GetInt64FromMap(m, "memory").value_or(0);
+        cpu_budget_ = cpu_budget ? *cpu_budget : 0;
+        result->Success();
+        return;
+    }
+
+    if (method == Method::SetCrashRecovery) {
+        const auto enabled = std::get_if<bool>(arguments);
+        if (!enabled) {
+            result->Error(kErrorInvalidArguments);
+            return;
+        }
+
+        crash_recovery_enabled_ = *enabled;
+        result->Success();
+        return;
+    }
+
+    if (method == Method::Discard) {
+        this->Discard();
+        result->Success();
+        return;
+    }
+    // A discarded browser is closed already.
+    if (method == Method::Dispose && this->IsDiscarded()) {
+        this->Close();
+        result->Success();
+        return;
+    }
 
     if (!this->browser_) {
+        std::unique_lock<std::mutex> lock(lifecycle_mutex_);
+        if (discarded_) {
+            // Replayed once the restored browser exists.
+            deferred_calls_.push_back({method, arguments ? *arguments : flutter::EncodableValue(), std::move(result)});
+            return;
+        }
+        lock.unlock();
         result->Error("browser not ready yet");
         return;
     }
 
-    if (method_call.method_name().compare("loadUrl") == 0) {
-        if (const auto url = std::get_if<std::string>(method_call.arguments())) {
+    switch (method) {
+    case Method::LoadUrl: {
+        if (const auto url = std::get_if<std::string>(arguments)) {
             this->loadUrl(*url);
             result->Success();
         } else {
             result->Error("url is required");
         }
+        break;
     }
-    else if (method_call.method_name().compare("setSize") == 0) {
-        auto tuple = GetPointAnDPIFromArgs(method_call.arguments());
+    case Method::SetSize: {
+        auto tuple = GetPointAnDPIFromArgs(arguments);
         if (tuple) {
             const auto [dpi, width, height, x, y] = tuple.value();
             this->changeSize(
@@ -572,93 +1251,155 @@ void WebviewHandler::HandleMethodCall(
         }
 
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("cursorClickDown") == 0) {
+    case Method::CursorClickDown: {
         this->Focus();
 
-        const auto point = GetPointFromArgs(method_call.arguments());
+        const auto point = GetPointFromArgs(arguments);
         this->cursorClick(point->first, point->second, false);
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("cursorClickUp") == 0) {
-        const auto point = GetPointFromArgs(method_call.arguments());
+    case Method::CursorClickUp: {
+        const auto point = GetPointFromArgs(arguments);
         this->cursorClick(point->first, point->second, true);
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("cursorMove") == 0) {
-        const auto point = GetPointFromArgs(method_call.arguments());
+    case Method::CursorMove: {
+        const auto point = GetPointFromArgs(arguments);
         this->cursorMove(point->first, point->second, false);
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("cursorDragging") == 0) {
-        const auto point = GetPointFromArgs(method_call.arguments());
+    case Method::CursorDragging: {
+        const auto point = GetPointFromArgs(arguments);
         this->cursorMove(point->first, point->second, true);
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("setScrollDelta") == 0) {
+    case Method::SetScrollDelta: {
         const flutter::EncodableList* list =
-            std::get_if<flutter::EncodableList>(method_call.arguments());
+            std::get_if<flutter::EncodableList>(arguments);
         const auto x = *std::get_if<int>(&(*list)[0]);
         const auto y = *std::get_if<int>(&(*list)[1]);
         const auto deltaX = *std::get_if<int>(&(*list)[2]);
         const auto deltaY = *std::get_if<int>(&(*list)[3]);
         this->sendScrollEvent(x, y, deltaX, deltaY);
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("setZoomLevel") == 0) {
-        const auto level = std::get_if<double>(method_call.arguments());
-        if (level) browser_->GetHost()->SetZoomLevel(*level);
+    case Method::SetZoomLevel: {
+        const auto level = std::get_if<double>(arguments);
+        if (level) {
+            browser_->GetHost()->SetZoomLevel(*level);
+            // SetZoomLevel is applied asynchronously on the UI thread.
+            CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::RefreshZoomLevel, this));
+        }
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("getZoomLevel") == 0) {
+    case Method::GetZoomLevel: {
         result->Success(browser_->GetHost()->GetZoomLevel());
+        break;
     }
-    else if (method_call.method_name().compare("unfocus") == 0) {
+    case Method::Unfocus: {
         this->Unfocus();
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("focus") == 0) {
+    case Method::Focus: {
         this->Focus();
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("goForward") == 0) {
+    case Method::GoForward: {
         this->goForward();
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("canGoForward") == 0) {
+    case Method::CanGoForward: {
         result->Success(flutter::EncodableValue(this->canGoForward()));
+        break;
     }
-    else if (method_call.method_name().compare("goBack") == 0) {
+    case Method::GoBack: {
         this->goBack();
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("canGoBack") == 0) {
+    case Method::CanGoBack: {
         result->Success(flutter::EncodableValue(this->canGoBack()));
+        break;
     }
-    else if (method_call.method_name().compare("stopLoad") == 0) {
+    case Method::StopLoad: {
         this->stopLoad();
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("reload") == 0) {
+    case Method::Reload: {
         this->reload();
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("openDevTools") == 0) {
+    case Method::OpenDevTools: {
         this->openDevTools();
         result->Success();
+        break;
+    }
+    case Method::EvaluateJavaScript: {
+        auto msg = async_channel_message::EvaluateJavaScript::CreateCefProcessMessage(arguments);
+        if (!msg) {
+            result->Error(kErrorInvalidArguments);
+            return;
+        }
+
+        this->SendCall(arguments, msg);
+        result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("evaluateJavaScript") == 0) {
-        auto msg = async_channel_message::EvaluateJavaScript::CreateCefProcessMessage(method_call.arguments());
+    case Method::EvaluateJavaScriptBatch: {
+        auto msg = async_channel_message::EvaluateJavaScriptBatch::CreateCefProcessMessage(arguments);
         if (!msg) {
             result->Error(kErrorInvalidArguments);
             return;
         }
 
-        this->browser_->GetMainFrame()->SendProcessMessage(PID_RENDERER, msg);
+        this->SendCall(arguments, msg);
+        result->Success();
+        break;
+    }
+    case Method::CancelPendingCalls: {
+        this->FailPendingCalls(async_channel_message::kErrorCanceled, true);
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("printToPDF") == 0) {
-        const flutter::EncodableMap* m = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    case Method::PostMessageToPage: {
+        const auto m = std::get_if<flutter::EncodableMap>(arguments);
+        if (!m || !m->count(flutter::EncodableValue("value"))) {
+            result->Error(kErrorInvalidArguments);
+            return;
+        }
+
+        const auto coalesce_key = util::GetStringFromMap(m, "coalesceKey");
+        this->PostMessageToPage(coalesce_key.value_or(""),
+                                util::EncodableValueToCefValue(m->at(flutter::EncodableValue("value"))));
+        result->Success();
+        break;
+    }
+    case Method::InvokeScript: {
+        auto msg = async_channel_message::InvokeScript::CreateCefProcessMessage(arguments);
+        if (!msg) {
+            result->Error(kErrorInvalidArguments);
+            return;
+        }
+
+        this->SendCall(arguments, msg);
+        result->Success();
+        break;
+    }
+    case Method::PrintToPDF: {
+        const flutter::EncodableMap* m = std::get_if<flutter::EncodableMap>(arguments);
 
         auto filepath = util::GetStringFromMap(m, "path");
         if (!filepath) {
@@ -681,25 +1422,37 @@ void WebviewHandler::HandleMethodCall(
         }
 
         this->PrintToPDF(*filepath, printSettings, std::move(result));
+        break;
     }
-    else if (method_call.method_name().compare("attachView") == 0) {
+    case Method::AttachView: {
         result->Success(flutter::EncodableValue(this->AttachView()));
+        break;
     }
-    else if (method_call.method_name().compare("deattachView") == 0) {
+    case Method::DeattachView: {
         this->DeattachView();
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("invalidate") == 0) {
+    case Method::Invalidate: {
         this->Invalidate();
         result->Success();
+        break;
     }
-    else if (method_call.method_name().compare("dispose") == 0) {
+    case Method::Dispose: {
         this->Unfocus();
 
-        this->browser_->GetHost()->CloseBrowser(false);
-        result->Success();
+        // Answered once the browser is gone. Forced, a beforeunload handler
+        // of the page could otherwise cancel the close and dispose would
+        // never return.
+        {
+            std::lock_guard<std::mutex> lock(lifecycle_mutex_);
+            if (dispose_result_) dispose_result_->Success();
+            dispose_result_ = std::move(result);
+        }
+        this->browser_->GetHost()->CloseBrowser(true);
+        break;
     }
-    else {
+    default:
         result->NotImplemented();
     }
 }
@@ -711,21 +1464,356 @@ bool WebviewHandler::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
 
     auto message_name = message->GetName();
     if (message_name == ipc::EvaluateJavaScriptResponse) {
+        // Large results skip the EncodableValue, see SendPayload.
+        if (auto region = message->GetSharedMemoryRegion()) {
+            const auto header = ipc::GetSharedMessageHeader(region);
+            if (header && this->CompleteCall(header->id)) {
+                WithRegistry([&](BrowserRegistry* registry) { registry->SendPayload(browser_id_, region); });
+            }
+            return true;
+        }
+
+        if (!this->CompleteCall(message->GetArgumentList()->GetInt(ipc::indexID))) return true;
+
         auto v = async_channel_message::EvaluateJavaScript::CreateFlutterChannelMessage(message);
         this->EmitAsyncChannelMessage(v);
         return true;
     }
+    if (message_name == ipc::PageMessageAck) {
+        {
+            std::lock_guard<std::mutex> lock(page_messages_mutex_);
+            if (page_messages_in_flight_ > 0) page_messages_in_flight_--;
+        }
+        this->FlushPageMessages();
+        return true;
+    }
+    if (message_name == ipc::HostMessage) {
+        // Transferred buffers go out on the payload channel, see SendPayload.
+        if (auto region = message->GetSharedMemoryRegion()) {
+            if (IsEventSubscribed(event_codec::EventType::HostMessage)) {
+                WithRegistry([&](BrowserRegistry* registry) { registry->SendPayload(browser_id_, region); });
+            }
+            return true;
+        }
+
+        if (IsEventSubscribed(event_codec::EventType::HostMessage)) {
+            EmitEvent(event_codec::EventType::HostMessage,
+                      util::CefValueToEncodableValue(message->GetArgumentList()->GetValue(ipc::indexHostMessageValue)));
+        }
+        return true;
+    }
+    if (message_name == ipc::EvaluateJavaScriptBatchResponse) {
+        if (!this->CompleteCall(message->GetArgumentList()->GetInt(ipc::indexID))) return true;
+
+        auto v = async_channel_message::EvaluateJavaScriptBatch::CreateFlutterChannelMessage(message);
+        this->EmitAsyncChannelMessage(v);
+        return true;
+    }
+    if (message_name == ipc::UserScriptsRequest) {
+        this->SendScripts(frame);
+        return true;
+    }
 
     return this->message_router_->OnProcessMessageReceived(browser, frame, source_process, message);
 }
 
+void WebviewHandler::OnCefQuery(int64_t query_id, const CefString& request, bool persistent,
+                                CefRefPtr<CefMessageRouterBrowserSide::Handler::Callback> callback) {
+    {
+        std::lock_guard<std::mutex> lock(pending_queries_mutex_);
+        pending_queries_[query_id] = PendingQuery{callback, persistent};
+    }
+
+    // The value the Dart handler returns answers the query, a persistent query
+    // stays pending for the responses sent with cefQueryRespond.
+    CefRefPtr<WebviewHandler> self(this);
+    auto result = std::make_unique<flutter::MethodResultFunctions<flutter::EncodableValue>>(
+        [self, query_id, persistent](const flutter::EncodableValue* value) {
+            const auto response = value ? std::get_if<std::string>(value) : nullptr;
+            if (response || !persistent) {
+                self->RespondQuery(query_id, response ? *response : std::string());
+            }
+        },
+        [self, query_id](const std::string& code, const std::string& message, const flutter::EncodableValue* details) {
+            const auto error_code = details ? std::get_if<int32_t>(details) : nullptr;
+            self->FailQuery(query_id, error_code ? *error_code : -1, message.empty() ? code : message);
+        },
+        [self, query_id]() {
+            self->FailQuery(query_id, -1, "onCefQuery is not handled");
+        });
+
+    WithRegistry([&](BrowserRegistry* registry) {
+        registry->InvokeMethod(browser_id_, "onCefQuery", flutter::EncodableValue(flutter::EncodableMap{
+            {flutter::EncodableValue("queryID"), flutter::EncodableValue(query_id)},
+            {flutter::EncodableValue("request"), flutter::EncodableValue(request.ToString())},
+            {flutter::EncodableValue("persistent"), flutter::EncodableValue(persistent)},
+        }), std::move(result));
+    });
+}
+
+bool WebviewHandler::RespondQuery(int64_t query_id, const std::string& response) {
+    CefRefPtr<CefMessageRouterBrowserSide::Handler::Callback> callback;
+    {
+        std::lock_guard<std::mutex> lock(pending_queries_mutex_);
+        auto it = pending_queries_.find(query_id);
+        if (it == pending_queries_.end()) return false;
+
+        callback = it->second.callback;
+        if (!it->second.persistent) pending_queries_.erase(it);
+    }
+    callback->Success(response);
+    return true;
+}
+
+void WebviewHandler::FailPendingQueries(const char* error) {
+    std::unordered_map<int64_t, PendingQuery> queries;
+    {
+        std::lock_guard<std::mutex> lock(pending_queries_mutex_);
+        queries.swap(pending_queries_);
+    }
+    for (auto& it : queries) {
+        it.second.callback->Failure(-1, error);
+    }
+}
+
+bool WebviewHandler::FailQuery(int64_t query_id, int error_code, const std::string& error_message) {
+    CefRefPtr<CefMessageRouterBrowserSide::Handler::Callback> callback;
+    {
+        std::lock_guard<std::mutex> lock(pending_queries_mutex_);
+        auto it = pending_queries_.find(query_id);
+        if (it == pending_queries_.end()) return false;
+
+        callback = it->second.callback;
+        pending_queries_.erase(it);
+    }
+    callback->Failure(error_code, error_message);
+    return true;
+}
+
+void WebviewHandler::SendCall(const flutter::EncodableValue* arguments, CefRefPtr<CefProcessMessage> message) {
+    const auto message_id = async_channel_message::GetMessageID(arguments);
+    {
+        std::lock_guard<std::mutex> lock(pending_calls_mutex_);
+        pending_calls_.insert(message_id);
+    }
+    if (const auto timeout = async_channel_message::GetTimeout(arguments)) {
+        CefPostDelayedTask(TID_UI, base::BindOnce(&WebviewHandler::FailCall, this, message_id,
+                                                  async_channel_message::kErrorTimedOut), *timeout);
+    }
+
+    this->browser_->GetMainFrame()->SendProcessMessage(PID_RENDERER, message);
+}
+
+bool WebviewHandler::CompleteCall(int message_id) {
+    std::lock_guard<std::mutex> lock(pending_calls_mutex_);
+    if (pending_calls_.erase(message_id) > 0) return true;
+
+    // The script Dart gave up on has finished after all.
+    terminate_unresponsive_renderer_ = false;
+    return false;
+}
+
+void WebviewHandler::FailCall(int message_id, const char* error) {
+    {
+        std::lock_guard<std::mutex> lock(pending_calls_mutex_);
+        if (pending_calls_.erase(message_id) == 0) return;
+        terminate_unresponsive_renderer_ = true;
+    }
+    this->EmitAsyncChannelMessage(async_channel_message::CreateFailureMessage({message_id}, error));
+}
+
+void WebviewHandler::FailPendingCalls(const char* error, bool terminate_unresponsive) {
+    std::vector<int> ids;
+    {
+        std::lock_guard<std::mutex> lock(pending_calls_mutex_);
+        if (pending_calls_.empty()) return;
+
+        ids.assign(pending_calls_.begin(), pending_calls_.end());
+        pending_calls_.clear();
+        terminate_unresponsive_renderer_ = terminate_unresponsive;
+    }
+    this->EmitAsyncChannelMessage(async_channel_message::CreateFailureMessage(ids, error));
+}
+
+void WebviewHandler::PostMessageToPage(const std::string& coalesce_key, CefRefPtr<CefValue> value) {
+    {
+        std::lock_guard<std::mutex> lock(page_messages_mutex_);
+        auto it = coalesce_key.empty() ? pending_page_messages_.end() :
+            std::find_if(pending_page_messages_.begin(), pending_page_messages_.end(),
+                         [&coalesce_key](const PendingPageMessage& m) { return m.coalesce_key == coalesce_key; });
+        if (it != pending_page_messages_.end()) {
+            it->value = value;
+        } else {
+            pending_page_messages_.push_back(PendingPageMessage{coalesce_key, value});
+        }
+    }
+    this->FlushPageMessages();
+}
+
+void WebviewHandler::FlushPageMessages() {
+    std::vector<CefRefPtr<CefValue>> values;
+    {
+        std::lock_guard<std::mutex> lock(page_messages_mutex_);
+        while (!pending_page_messages_.empty() && page_messages_in_flight_ < ipc::kPageMessageWindow) {
+            values.push_back(pending_page_messages_.front().value);
+            pending_page_messages_.pop_front();
+            page_messages_in_flight_++;
+        }
+    }
+
+    auto browser = this->browser_;
+    if (!browser) return;
+    for (const auto& value : values) {
+        auto msg = CefProcessMessage::Create(ipc::PageMessage);
+        msg->GetArgumentList()->SetValue(ipc::indexPageMessageValue, value);
+        browser->GetMainFrame()->SendProcessMessage(PID_RENDERER, msg);
+    }
+}
+
+// static
+CefRefPtr<CefProcessMessage> WebviewHandler::CreateAddUserScriptMessage(int id, const UserScript& script) {
+    auto msg = CefProcessMessage::Create(ipc::AddUserScript);
+    auto args = msg->GetArgumentList();
+    args->SetInt(ipc::indexUserScriptID, id);
+    args->SetString(ipc::indexUserScriptSource, script.source);
+    args->SetInt(ipc::indexUserScriptInjectionTime, static_cast<int>(script.injection_time));
+    args->SetBool(ipc::indexUserScriptAllFrames, script.all_frames);
+    return msg;
+}
+
+void WebviewHandler::OnRenderViewReady(CefRefPtr<CefBrowser> browser) {
+    CEF_REQUIRE_UI_THREAD();
+
+    // Messages in flight to a previous render process are never acknowledged.
+    {
+        std::lock_guard<std::mutex> lock(page_messages_mutex_);
+        page_messages_in_flight_ = 0;
+    }
+
+    this->FlushPageMessages();
+}
+
+CefRefPtr<CefDictionaryValue> WebviewHandler::CreateExtraInfo() {
+    auto user_scripts = CefListValue::Create();
+    {
+        std::lock_guard<std::mutex> lock(user_scripts_mutex_);
+        for (const auto& [id, script] : user_scripts_) {
+            user_scripts->SetList(user_scripts->GetSize(), CreateAddUserScriptMessage(id, script)->GetArgumentList());
+        }
+    }
+    auto registered_scripts = CefListValue::Create();
+    {
+        std::lock_guard<std::mutex> lock(registered_scripts_mutex_);
+        for (const auto& [handle, source] : registered_scripts_) {
+            registered_scripts->SetList(
+                registered_scripts->GetSize(),
+                async_channel_message::InvokeScript::CreateRegisterMessage(handle, source)->GetArgumentList());
+        }
+    }
+
+    auto extra_info = CefDictionaryValue::Create();
+    extra_info->SetInt(ipc::extraInfoControllerID, browser_id_);
+    extra_info->SetList(ipc::extraInfoUserScripts, user_scripts);
+    extra_info->SetList(ipc::extraInfoRegisteredScripts, registered_scripts);
+    return extra_info;
+}
+
+void WebviewHandler::SendControllerID(CefRefPtr<CefFrame> frame) {
+    auto msg = CefProcessMessage::Create(ipc::SetControllerID);
+    msg->GetArgumentList()->SetInt(ipc::indexControllerID, browser_id_);
+    frame->SendProcessMessage(PID_RENDERER, msg);
+}
+
+void WebviewHandler::SendScripts(CefRefPtr<CefFrame> frame) {
+    // Scripts the renderer already got with the extra info are replaced by
+    // the same ones, and so is the controller id.
+    this->SendControllerID(frame);
+    {
+        std::lock_guard<std::mutex> lock(user_scripts_mutex_);
+        for (const auto& [id, script] : user_scripts_) {
+            frame->SendProcessMessage(PID_RENDERER, CreateAddUserScriptMessage(id, script));
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(registered_scripts_mutex_);
+        for (const auto& [handle, source] : registered_scripts_) {
+            frame->SendProcessMessage(PID_RENDERER,
+                                      async_channel_message::InvokeScript::CreateRegisterMessage(handle, source));
+        }
+    }
+}
+
+bool WebviewHandler::OnRenderProcessUnresponsive(CefRefPtr<CefBrowser> browser,
+                                                 CefRefPtr<CefUnresponsiveProcessCallback> callback) {
+    CEF_REQUIRE_UI_THREAD();
+
+    // V8 cannot be interrupted through CEF, terminating the renderer is the
+    // only way to stop a script Dart gave up on.
+    std::lock_guard<std::mutex> lock(pending_calls_mutex_);
+    if (!terminate_unresponsive_renderer_) return false;
+
+    callback->Terminate();
+    return true;
+}
+
+void WebviewHandler::OnRenderProcessResponsive(CefRefPtr<CefBrowser> browser) {
+    CEF_REQUIRE_UI_THREAD();
+
+    std::lock_guard<std::mutex> lock(pending_calls_mutex_);
+    terminate_unresponsive_renderer_ = false;
+}
+
 void WebviewHandler::OnRenderProcessTerminated(CefRefPtr<CefBrowser> browser,
                                                TerminationStatus status,
                                                int error_code,
                                                const CefString& error_string) {
     CEF_REQUIRE_UI_THREAD();
 
+    // A discarded browser.
+    if (!this->browser_ || !this->browser_->IsSame(browser)) return;
+
     this->message_router_->OnRenderProcessTerminated(browser);
+    this->FailPendingCalls(async_channel_message::kErrorRenderProcessTerminated, false);
+
+    // A renderer that outlived kCrashRecoveryStablePeriod starts the backoff
+    // over, one that keeps crashing is given up on.
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_crash_ > kCrashRecoveryStablePeriod) consecutive_crashes_ = 0;
+    last_crash_ = now;
+    consecutive_crashes_++;
+
+    int64_t recovery_delay = -1;
+    if (crash_recovery_enabled_ && consecutive_crashes_ <= kCrashRecoveryMaxAttempts) {
+        recovery_delay = std::min(kCrashRecoveryInitialDelay.count() << (consecutive_crashes_ - 1),
+                                  kCrashRecoveryMaxDelay.count());
+
+        // The frame lost its URL with its process, the navigation state has
+        // the last committed one.
+        std::string url = navigation_state_.url;
+        if (url.empty()) url = browser->GetMainFrame()->GetURL();
+        CefPostDelayedTask(TID_UI, base::BindOnce(&WebviewHandler::RecoverRenderProcess, this,
+                                                  browser->GetIdentifier(), url), recovery_delay);
+    }
+
+    EmitEvent(event_codec::EventType::RenderProcessGone, flutter::EncodableMap{
+        {flutter::EncodableValue("reason"), flutter::EncodableValue(TerminationStatusName(status))},
+        {flutter::EncodableValue("errorCode"), flutter::EncodableValue(error_code)},
+        {flutter::EncodableValue("errorString"), flutter::EncodableValue(error_string.ToString())},
+        {flutter::EncodableValue("recoveryDelay"), flutter::EncodableValue(recovery_delay)},
+    });
+}
+
+void WebviewHandler::RecoverRenderProcess(int browser_identifier, std::string url) {
+    CEF_REQUIRE_UI_THREAD();
+
+    // The browser was closed or discarded meanwhile.
+    if (!this->browser_ || this->browser_->GetIdentifier() != browser_identifier) return;
+
+    // The new render process asks for the user scripts and registered
+    // scripts when it gets the browser, see SendScripts.
+    pending_scroll_offset_ = scroll_offset_;
+    pending_zoom_level_ = navigation_state_.zoom_level;
+    this->browser_->GetMainFrame()->LoadURL(url.empty() ? "about:blank" : url);
 }
 
 bool WebviewHandler::OnBeforeBrowse(CefRefPtr<CefBrowser> browser,
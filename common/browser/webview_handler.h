@@ -7,34 +7,32 @@
 #pragma once
 
 #include "include/cef_client.h"
+#include "include/cef_request_context.h"
+#include "include/cef_task_manager.h"
 #include "include/wrapper/cef_message_router.h"
 #include "texture_handler.h"
-#include <flutter/method_channel.h>
+#include "event_codec.h"
+#include "browser_registry.h"
+#include "message.h"
 #include <flutter/standard_method_codec.h>
-#include <flutter/binary_messenger.h>
-#include <flutter/event_channel.h>
 #include <flutter/method_result.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace
 {
 
-constexpr auto kEventType = "type";
-constexpr auto kEventValue = "value";
-
-constexpr auto kEventTitleChanged = "titleChanged";
-constexpr auto kEventURLChanged = "urlChanged";
-constexpr auto kEventCursorChanged = "cursorChanged";
-constexpr auto kEventLoadingProgressChanged = "loadingProgressChanged";
-constexpr auto kEventScrollOffsetChanged = "scrollOffsetChanged";
-constexpr auto kEventLoadingStateChanged = "loadingStateChanged";
-constexpr auto kEventLoadStart = "loadStart";
-constexpr auto kEventLoadEnd = "loadEnd";
-constexpr auto kEventLoadError = "loadError";
-constexpr auto kEventIMEComposionPositionChanged = "imeComposionPositionChanged";
-constexpr auto kEventAsyncChannelMessage = "asyncChannelMessage";
-
 constexpr auto kErrorInvalidArguments = "InvalidArguments";
 
 }
@@ -53,7 +51,56 @@ public:
                         const CefRange& selection_range,
                         const CefRenderHandler::RectList& character_bounds)> onImeCompositionRangeChangedCallback;
 
-    explicit WebviewHandler(flutter::BinaryMessenger* messenger, int browser_id, float dpi);
+    // Commands Dart sends through the BrowserRegistry, the method name is
+    // resolved once by MethodFromName.
+    enum class Method {
+        SetEventSubscriptions,
+        LoadUrl,
+        SetSize,
+        CursorClickDown,
+        CursorClickUp,
+        CursorMove,
+        CursorDragging,
+        SetScrollDelta,
+        SetZoomLevel,
+        GetZoomLevel,
+        Unfocus,
+        Focus,
+        GoForward,
+        CanGoForward,
+        GoBack,
+        CanGoBack,
+        StopLoad,
+        Reload,
+        OpenDevTools,
+        EvaluateJavaScript,
+        EvaluateJavaScriptBatch,
+        CancelPendingCalls,
+        PostMessageToPage,
+        CefQueryRespond,
+        CefQueryFail,
+        AddUserScript,
+        RemoveUserScript,
+        RegisterScript,
+        UnregisterScript,
+        InvokeScript,
+        SetResourceBudget,
+        SetCrashRecovery,
+        PrintToPDF,
+        AttachView,
+        DeattachView,
+        Invalidate,
+        Discard,
+        Dispose,
+    };
+
+    // Id of a pooled browser no controller owns, the ids Dart hands out start
+    // at 1.
+    static constexpr int kPooledBrowserID = 0;
+
+    explicit WebviewHandler(BrowserRegistry* registry, flutter::TextureRegistrar* texture_registrar,
+                            int browser_id, float dpi,
+                            event_codec::EventEncoding event_encoding = event_codec::EventEncoding::Map);
     ~WebviewHandler();
 
     // CefClient methods:
@@ -142,6 +189,10 @@ public:
                         CefRefPtr<CefRequest> request,
                         bool user_gesture,
                         bool is_redirect) override;
+    void OnRenderViewReady(CefRefPtr<CefBrowser> browser) override;
+    bool OnRenderProcessUnresponsive(CefRefPtr<CefBrowser> browser,
+                                     CefRefPtr<CefUnresponsiveProcessCallback> callback) override;
+    void OnRenderProcessResponsive(CefRefPtr<CefBrowser> browser) override;
     void OnRenderProcessTerminated(CefRefPtr<CefBrowser> browser,
                                    TerminationStatus status,
                                    int error_code,
@@ -171,12 +222,68 @@ public:
 
     void PrintToPDF(std::string path, const CefPdfPrintSettings& settings, std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
+    // Pooled browsers, see BrowserPool.
+    // Binds the browser to the controller |browser_id|, which gets
+    // onBrowserCreated right away if the browser already exists.
+    void Adopt(int browser_id, float dpi, event_codec::EventEncoding event_encoding);
+    // Detaches the browser from its controller and drops the state the
+    // controller left, then loads about:blank. Returns false if the browser
+    // does not exist. Not named Release, which CefRefPtr calls to drop a
+    // reference.
+    bool ResetForPool();
+    // Clears the storage of the origin of the current page.
+    void ClearStorage();
+    bool IsBrowserCreated();
+    // Closes the browser, as soon as it is created if it is not yet.
+    void Close();
+    // Called by the engine of the browser before it goes away. Unregisters
+    // the texture and drops the registry, nothing reaches the engine once it
+    // returns, then closes the browser.
+    void DetachFromEngine();
+
+    // Discard closes the browser but keeps the handler, its texture showing
+    // the last frame and the state Dart set up. Restore creates a new browser
+    // on the page the old one showed, calls arriving in between wait for it.
+    void Discard();
+    void Restore();
+    // True while the browser is discarded and not being restored.
+    bool IsDiscarded();
+
+    int browser_id() const { return browser_id_; }
+
+    // Context of the browser, nullptr for the global one. Set before the
+    // browser is created, it is kept when the browser is restored. Browsers
+    // of different contexts never share a renderer process, the name of the
+    // context is the process group of the browser. An unnamed context has no
+    // name to share, the browser is a group of its own.
+    void SetRequestContext(CefRefPtr<CefRequestContext> request_context, const std::string& name) {
+        request_context_ = request_context;
+        request_context_name_ = name;
+    }
+    CefRefPtr<CefRequestContext> GetRequestContext() const { return request_context_; }
+    const std::string& GetRequestContextName() const { return request_context_name_; }
+
+    // Extra info of CreateBrowser, the scripts the browser starts with. Every
+    // renderer process of the browser gets it before its first page.
+    CefRefPtr<CefDictionaryValue> CreateExtraInfo();
+
+    // Resource usage, see ResourceSampler. Only called on the CEF UI thread.
+    // Returns the task of the browser, -1 if it has none.
+    int64_t GetTaskId(CefRefPtr<CefTaskManager> task_manager);
+    // |memory| is the footprint of the renderer process in bytes, -1 if
+    // unknown, |cpu_usage| its CPU usage, 100 per fully used processor.
+    void OnResourceUsage(int64_t memory, double cpu_usage);
+
     // Returns texture_id
     int64_t AttachView();
     void DeattachView();
     void Invalidate();
 
-    static const CefRefPtr<CefBrowser> CurrentFocusedBrowser();
+    static std::optional<Method> MethodFromName(const std::string& name);
+    void HandleMethodCall(
+        Method method,
+        const flutter::EncodableValue* arguments,
+        std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
 private:
     uint32_t width_ = 1;
@@ -184,45 +291,207 @@ private:
     int x_ = 0;
     int y_ = 0;
     float dpi_ = 1.0;
+    // Owned by the engine that created this browser, null once it went away,
+    // see DetachFromEngine. engine_mutex_ is held while they are used, and
+    // while the texture and onPaintCallback are.
+    BrowserRegistry* registry_;
+    flutter::TextureRegistrar* texture_registrar_;
+    std::mutex engine_mutex_;
+    // Runs |f| with the registry unless the engine is gone.
+    template <typename F>
+    void WithRegistry(F&& f) {
+        std::lock_guard<std::mutex> lock(engine_mutex_);
+        if (registry_) f(registry_);
+    }
+    // Changes when a pooled browser is leased or released.
+    std::atomic<int> browser_id_;
+    CefRefPtr<CefRequestContext> request_context_;
+    std::string request_context_name_;
+    // Guards the creation state against Adopt and Close on the Flutter
+    // platform thread.
+    bool browser_created_ = false;
+    bool close_on_created_ = false;
+    bool discarded_ = false;
+    bool restoring_ = false;
+    std::string discarded_url_;
+    struct DeferredCall {
+        Method method;
+        flutter::EncodableValue arguments;
+        std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result;
+    };
+    std::vector<DeferredCall> deferred_calls_;
+    // The dispose call waiting for OnBeforeClose.
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> dispose_result_;
+    std::mutex lifecycle_mutex_;
+    // Last scroll offset of the page, put back after a restore. Only accessed
+    // on the CEF UI thread.
+    std::pair<double, double> scroll_offset_;
+    std::optional<std::pair<double, double>> pending_scroll_offset_;
+    std::optional<double> pending_zoom_level_;
+
+    // Reloads the page after its render process died, with an exponential
+    // backoff between consecutive crashes. The backoff state is only accessed
+    // on the CEF UI thread.
+    void RecoverRenderProcess(int browser_identifier, std::string url);
+    std::atomic<bool> crash_recovery_enabled_{true};
+    int consecutive_crashes_ = 0;
+    std::chrono::steady_clock::time_point last_crash_;
     bool is_dragging_ = false;
     bool is_focused_ = false;
     CefRect _prevIMEPosition = CefRect();
 
+    // Snapshot pushed to Dart so the navigation getters never round trip.
+    // Only accessed on the CEF UI thread.
+    struct NavigationState {
+        std::string url;
+        std::string title;
+        bool can_go_back = false;
+        bool can_go_forward = false;
+        bool is_loading = false;
+        double zoom_level = 0;
+
+        bool operator==(const NavigationState& other) const {
+            return url == other.url && title == other.title &&
+                can_go_back == other.can_go_back && can_go_forward == other.can_go_forward &&
+                is_loading == other.is_loading && zoom_level == other.zoom_level;
+        }
+        bool operator!=(const NavigationState& other) const { return !(*this == other); }
+    };
+    NavigationState navigation_state_;
+
+    // Ids of the async channel messages sent to the renderer and not answered
+    // yet, failed at once if the renderer goes away. Accessed from the CEF UI
+    // thread and from the Flutter platform thread.
+    std::unordered_set<int> pending_calls_;
+    // Set once a call timed out or was canceled, the hang monitor then
+    // terminates the renderer instead of waiting for the runaway script.
+    bool terminate_unresponsive_renderer_ = false;
+    std::mutex pending_calls_mutex_;
+
+    // Tracks the call |arguments| describes, with its timeout if it has one,
+    // and sends |message| for it.
+    void SendCall(const flutter::EncodableValue* arguments, CefRefPtr<CefProcessMessage> message);
+    // Returns false if the call already failed, its late response is dropped.
+    bool CompleteCall(int message_id);
+    void FailCall(int message_id, const char* error);
+    // |terminate_unresponsive| is true if Dart gave up on the calls, their
+    // scripts may still be running.
+    void FailPendingCalls(const char* error, bool terminate_unresponsive);
+
+    // cefQuery requests waiting for Dart, by query id. Accessed from the CEF
+    // UI thread and from the Flutter platform thread.
+    struct PendingQuery {
+        CefRefPtr<CefMessageRouterBrowserSide::Handler::Callback> callback;
+        bool persistent;
+    };
+    std::unordered_map<int64_t, PendingQuery> pending_queries_;
+    std::mutex pending_queries_mutex_;
+
+    void OnCefQuery(int64_t query_id, const CefString& request, bool persistent,
+                    CefRefPtr<CefMessageRouterBrowserSide::Handler::Callback> callback);
+    // Return false if the query is no longer pending. A response keeps a
+    // persistent query pending, a failure always ends it.
+    bool RespondQuery(int64_t query_id, const std::string& response);
+    bool FailQuery(int64_t query_id, int error_code, const std::string& error_message);
+    void FailPendingQueries(const char* error);
+
+    // Messages for the page waiting for the renderer to catch up, see
+    // ipc::kPageMessageWindow. Accessed from the CEF UI thread and from the
+    // Flutter platform thread.
+    struct PendingPageMessage {
+        // Empty if the message is never replaced.
+        std::string coalesce_key;
+        CefRefPtr<CefValue> value;
+    };
+    std::deque<PendingPageMessage> pending_page_messages_;
+    int page_messages_in_flight_ = 0;
+    std::mutex page_messages_mutex_;
+
+    // A message with the key of a waiting one replaces it in place.
+    void PostMessageToPage(const std::string& coalesce_key, CefRefPtr<CefValue> value);
+    // Sends waiting messages while the window allows it.
+    void FlushPageMessages();
+
+    // Scripts added with addUserScript by id, given to every new renderer
+    // process of the browser like the registered scripts.
+    struct UserScript {
+        std::string source;
+        ipc::UserScriptInjectionTime injection_time;
+        bool all_frames;
+    };
+    std::map<int, UserScript> user_scripts_;
+    int next_user_script_id_ = 0;
+    std::mutex user_scripts_mutex_;
+
+    static CefRefPtr<CefProcessMessage> CreateAddUserScriptMessage(int id, const UserScript& script);
+    // Sends the user and registered scripts to the renderer process of
+    // |frame|, which asked for them with a UserScriptsRequest.
+    void SendScripts(CefRefPtr<CefFrame> frame);
+    // Tells the renderer process of |frame| the current browser id, see
+    // ipc::SetControllerID.
+    void SendControllerID(CefRefPtr<CefFrame> frame);
+
+    // Sources of the scripts registered with registerScript by handle.
+    std::map<int, std::string> registered_scripts_;
+    // Zero if unlimited. onResourceBudgetExceeded is sent when a sample goes
+    // over a budget after one that did not.
+    std::atomic<int64_t> memory_budget_{0};
+    std::atomic<double> cpu_budget_{0};
+    bool over_budget_ = false;
+    int next_script_handle_ = 0;
+    std::mutex registered_scripts_mutex_;
+
     CefRefPtr<CefBrowser> browser_;
-    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> browser_channel_;
-    std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> event_sink_;
-    std::unique_ptr<flutter::EventChannel<flutter::EncodableValue>> event_channel_;
 
     // Handles the browser side of query routing.
     CefRefPtr<CefMessageRouterBrowserSide> message_router_;
     std::unique_ptr<CefMessageRouterBrowserSide::Handler> message_handler_;
 
+    struct EventSubscription {
+        bool subscribed = false;
+        // Minimum interval between two emitted events, zero if unthrottled.
+        std::chrono::milliseconds min_interval{0};
+        std::chrono::steady_clock::time_point last_emitted;
+        // Latest encoded event held back by the rate limit, flushed once the
+        // interval elapses.
+        std::optional<flutter::EncodableValue> pending_event;
+    };
+
+    event_codec::EventEncoding event_encoding_;
+    // Every event is emitted until Dart registers its subscriptions.
+    bool has_event_subscriptions_ = false;
+    std::array<EventSubscription, event_codec::kSubscribableEventCount> event_subscriptions_;
+    std::mutex event_subscriptions_mutex_;
+
     void Focus();
     void Unfocus();
 
-    void HandleMethodCall(
-      const flutter::MethodCall<flutter::EncodableValue> &method_call,
-      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+    void SetNavigationState(const NavigationState& state);
+    void RefreshZoomLevel();
+
+    void SetEventSubscriptions(const flutter::EncodableMap& subscriptions);
+    // Returns false if nobody listens to |type|, callers check it before
+    // building the event payload.
+    bool IsEventSubscribed(event_codec::EventType type);
+    // Returns true if the event can be sent now, otherwise |event| is kept
+    // and sent when the rate limit of |type| allows it.
+    bool ConsumeEventBudget(event_codec::EventType type, const flutter::EncodableValue& event);
+    void FlushThrottledEvent(event_codec::EventType type);
+    // Sends an event built with event_codec, subject to the rate limit of |type|.
+    void EmitEncodedEvent(event_codec::EventType type, const flutter::EncodableValue& event);
 
     template <typename T>
-    void EmitEvent(const std::string eventType, const T& value) {
-        if (event_sink_) {
-            const auto event = flutter::EncodableValue(flutter::EncodableMap{
-                {flutter::EncodableValue(kEventType), flutter::EncodableValue(eventType)},
-                {flutter::EncodableValue(kEventValue), flutter::EncodableValue(value)},
-            });
-            event_sink_->Success(event);
-        }
+    void EmitEvent(event_codec::EventType type, const T& value) {
+        if (!IsEventSubscribed(type)) return;
+
+        EmitEncodedEvent(type, event_codec::EncodeEvent(event_encoding_, browser_id_, type, flutter::EncodableValue(value)));
     }
 
     void EmitAsyncChannelMessage(const flutter::EncodableValue value) {
-        if (event_sink_) {
-            const auto event = flutter::EncodableValue(flutter::EncodableMap{
-                {flutter::EncodableValue(kEventType), flutter::EncodableValue(kEventAsyncChannelMessage)},
-                {flutter::EncodableValue(kEventValue), value},
-            });
-            event_sink_->Success(event);
-        }
+        WithRegistry([&](BrowserRegistry* registry) {
+            registry->EmitEvent(event_codec::EncodeEvent(
+                event_encoding_, browser_id_, event_codec::EventType::AsyncChannelMessage, value));
+        });
     }
 
     // Include the default reference counting implementation.
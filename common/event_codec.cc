@@ -0,0 +1,200 @@
+#include "event_codec.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    using event_codec::EventEncoding;
+    using event_codec::EventType;
+
+    const std::string keyType = "type";
+    const std::string keyBrowserID = "browserID";
+    const std::string keyValue = "value";
+
+    struct EventName {
+        EventType type;
+        const char* name;
+    };
+
+    const EventName kEventNames[] = {
+        {EventType::TitleChanged, "titleChanged"},
+        {EventType::URLChanged, "urlChanged"},
+        {EventType::CursorChanged, "cursorChanged"},
+        {EventType::LoadingProgressChanged, "loadingProgressChanged"},
+        {EventType::ScrollOffsetChanged, "scrollOffsetChanged"},
+        {EventType::LoadingStateChanged, "loadingStateChanged"},
+        {EventType::LoadStart, "loadStart"},
+        {EventType::LoadEnd, "loadEnd"},
+        {EventType::LoadError, "loadError"},
+        {EventType::IMEComposionPositionChanged, "imeComposionPositionChanged"},
+        {EventType::NavigationStateChanged, "navigationStateChanged"},
+        {EventType::HostMessage, "hostMessage"},
+        {EventType::ResourceUsage, "resourceUsage"},
+        {EventType::RenderProcessGone, "renderProcessGone"},
+        {EventType::AsyncChannelMessage, "asyncChannelMessage"},
+    };
+
+    flutter::EncodableValue EncodeMapEvent(int32_t browser_id, EventType type, const flutter::EncodableValue& value) {
+        return flutter::EncodableValue(flutter::EncodableMap{
+            {flutter::EncodableValue(keyType), flutter::EncodableValue(event_codec::EventTypeName(type))},
+            {flutter::EncodableValue(keyBrowserID), flutter::EncodableValue(browser_id)},
+            {flutter::EncodableValue(keyValue), value},
+        });
+    }
+
+    flutter::EncodableValue EncodePoint(double x, double y) {
+        return flutter::EncodableValue(flutter::EncodableMap{
+            {flutter::EncodableValue("x"), flutter::EncodableValue(x)},
+            {flutter::EncodableValue("y"), flutter::EncodableValue(y)},
+        });
+    }
+
+    flutter::EncodableValue EncodePoint(int32_t x, int32_t y) {
+        return flutter::EncodableValue(flutter::EncodableMap{
+            {flutter::EncodableValue("x"), flutter::EncodableValue(x)},
+            {flutter::EncodableValue("y"), flutter::EncodableValue(y)},
+        });
+    }
+
+    // Writes the compact header followed by the raw |fields|. All supported
+    // platforms are little-endian, so the fields are copied as they are.
+    template <typename... Fields>
+    flutter::EncodableValue EncodeFixedLayout(EventType type, int32_t browser_id, Fields... fields) {
+        std::vector<uint8_t> buffer(event_codec::kCompactHeaderSize + (sizeof(Fields) + ... + 0));
+        buffer[0] = static_cast<uint8_t>(type);
+        std::memcpy(buffer.data() + 4, &browser_id, sizeof(browser_id));
+
+        auto offset = event_codec::kCompactHeaderSize;
+        ((std::memcpy(buffer.data() + offset, &fields, sizeof(Fields)), offset += sizeof(Fields)), ...);
+        return flutter::EncodableValue(std::move(buffer));
+    }
+
+    template <typename T>
+    T ReadField(const std::vector<uint8_t>& buffer, size_t index) {
+        T v;
+        std::memcpy(&v, buffer.data() + event_codec::kCompactHeaderSize + index * sizeof(T), sizeof(T));
+        return v;
+    }
+
+    std::optional<event_codec::DecodedEvent> DecodeFixedLayout(const std::vector<uint8_t>& buffer) {
+        if (buffer.size() < event_codec::kCompactHeaderSize) return std::nullopt;
+
+        const auto type = static_cast<EventType>(buffer[0]);
+        int32_t browser_id;
+        std::memcpy(&browser_id, buffer.data() + 4, sizeof(browser_id));
+        const auto payload_size = buffer.size() - event_codec::kCompactHeaderSize;
+        switch (type) {
+        case EventType::CursorChanged:
+            if (payload_size != sizeof(int32_t)) return std::nullopt;
+            return event_codec::DecodedEvent{type, browser_id, flutter::EncodableValue(ReadField<int32_t>(buffer, 0))};
+        case EventType::LoadingProgressChanged:
+            if (payload_size != sizeof(double)) return std::nullopt;
+            return event_codec::DecodedEvent{type, browser_id, flutter::EncodableValue(ReadField<double>(buffer, 0))};
+        case EventType::ScrollOffsetChanged:
+            if (payload_size != 2 * sizeof(double)) return std::nullopt;
+            return event_codec::DecodedEvent{type, browser_id, EncodePoint(ReadField<double>(buffer, 0), ReadField<double>(buffer, 1))};
+        case EventType::IMEComposionPositionChanged:
+            if (payload_size != 2 * sizeof(int32_t)) return std::nullopt;
+            return event_codec::DecodedEvent{type, browser_id, EncodePoint(ReadField<int32_t>(buffer, 0), ReadField<int32_t>(buffer, 1))};
+        default:
+            return std::nullopt;
+        }
+    }
+}
+
+namespace event_codec
+{
+
+const char* EventTypeName(EventType type) {
+    for (const auto& e : kEventNames) {
+        if (e.type == type) return e.name;
+    }
+    return "";
+}
+
+std::optional<EventType> EventTypeFromName(const std::string& name) {
+    for (const auto& e : kEventNames) {
+        if (name == e.name) return e.type;
+    }
+    return std::nullopt;
+}
+
+std::optional<EventEncoding> EventEncodingFromName(const std::string& name) {
+    if (name == "map") return EventEncoding::Map;
+    if (name == "compact") return EventEncoding::Compact;
+    return std::nullopt;
+}
+
+flutter::EncodableValue EncodeEvent(EventEncoding encoding, int32_t browser_id, EventType type,
+                                    const flutter::EncodableValue& value) {
+    if (encoding == EventEncoding::Map) {
+        return EncodeMapEvent(browser_id, type, value);
+    }
+
+    return flutter::EncodableValue(flutter::EncodableList{
+        flutter::EncodableValue(static_cast<int32_t>(type)),
+        flutter::EncodableValue(browser_id),
+        value,
+    });
+}
+
+flutter::EncodableValue EncodeCursorChanged(EventEncoding encoding, int32_t browser_id, int32_t cursor_type) {
+    if (encoding == EventEncoding::Map) {
+        return EncodeMapEvent(browser_id, EventType::CursorChanged, flutter::EncodableValue(cursor_type));
+    }
+    return EncodeFixedLayout(EventType::CursorChanged, browser_id, cursor_type);
+}
+
+flutter::EncodableValue EncodeLoadingProgressChanged(EventEncoding encoding, int32_t browser_id, double progress) {
+    if (encoding == EventEncoding::Map) {
+        return EncodeMapEvent(browser_id, EventType::LoadingProgressChanged, flutter::EncodableValue(progress));
+    }
+    return EncodeFixedLayout(EventType::LoadingProgressChanged, browser_id, progress);
+}
+
+flutter::EncodableValue EncodeScrollOffsetChanged(EventEncoding encoding, int32_t browser_id, double x, double y) {
+    if (encoding == EventEncoding::Map) {
+        return EncodeMapEvent(browser_id, EventType::ScrollOffsetChanged, EncodePoint(x, y));
+    }
+    return EncodeFixedLayout(EventType::ScrollOffsetChanged, browser_id, x, y);
+}
+
+flutter::EncodableValue EncodeIMEComposionPositionChanged(EventEncoding encoding, int32_t browser_id,
+                                                          int32_t x, int32_t y) {
+    if (encoding == EventEncoding::Map) {
+        return EncodeMapEvent(browser_id, EventType::IMEComposionPositionChanged, EncodePoint(x, y));
+    }
+    return EncodeFixedLayout(EventType::IMEComposionPositionChanged, browser_id, x, y);
+}
+
+std::optional<DecodedEvent> DecodeEvent(const flutter::EncodableValue& event) {
+    if (const auto buffer = std::get_if<std::vector<uint8_t>>(&event)) {
+        return DecodeFixedLayout(*buffer);
+    }
+
+    if (const auto list = std::get_if<flutter::EncodableList>(&event)) {
+        if (list->size() != 3) return std::nullopt;
+        const auto id = std::get_if<int32_t>(&(*list)[0]);
+        const auto browser_id = std::get_if<int32_t>(&(*list)[1]);
+        if (!id || !browser_id) return std::nullopt;
+        return DecodedEvent{static_cast<EventType>(*id), *browser_id, (*list)[2]};
+    }
+
+    if (const auto map = std::get_if<flutter::EncodableMap>(&event)) {
+        const auto type_it = map->find(flutter::EncodableValue(keyType));
+        const auto browser_id_it = map->find(flutter::EncodableValue(keyBrowserID));
+        const auto value_it = map->find(flutter::EncodableValue(keyValue));
+        if (type_it == map->end() || browser_id_it == map->end() || value_it == map->end()) return std::nullopt;
+
+        const auto name = std::get_if<std::string>(&type_it->second);
+        const auto type = name ? EventTypeFromName(*name) : std::nullopt;
+        const auto browser_id = std::get_if<int32_t>(&browser_id_it->second);
+        if (!type || !browser_id) return std::nullopt;
+        return DecodedEvent{*type, *browser_id, value_it->second};
+    }
+
+    return std::nullopt;
+}
+
+} // namespace event_codec
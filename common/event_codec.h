@@ -0,0 +1,79 @@
+#ifndef COMMON_EVENT_CODEC_H_
+#define COMMON_EVENT_CODEC_H_
+#pragma once
+
+#include <flutter/standard_method_codec.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace event_codec
+{
+
+// Numeric event ids. The subscribable ones must match the index of
+// WebViewEvent in lib/src/webview_controller.dart.
+enum class EventType : uint8_t {
+    TitleChanged = 0,
+    URLChanged,
+    CursorChanged,
+    LoadingProgressChanged,
+    ScrollOffsetChanged,
+    LoadingStateChanged,
+    LoadStart,
+    LoadEnd,
+    LoadError,
+    IMEComposionPositionChanged,
+    NavigationStateChanged,
+    HostMessage,
+    ResourceUsage,
+    RenderProcessGone,
+
+    // Internal events, always delivered.
+    AsyncChannelMessage = 128,
+};
+
+constexpr size_t kSubscribableEventCount =
+    static_cast<size_t>(EventType::RenderProcessGone) + 1;
+
+// All browsers of an engine share one event channel, so every encoding carries
+// the id of the browser the event belongs to.
+enum class EventEncoding {
+    // {type: name, browserID: id, value: value} maps, kept for compatibility.
+    Map,
+    // Fixed-layout byte buffers for the high frequency events, [id, browserID,
+    // value] lists for the others.
+    Compact,
+};
+
+// Compact byte buffers start with the event id padded to 4 bytes and the
+// int32 browser id, followed by the little-endian payload.
+constexpr size_t kCompactHeaderSize = 8;
+
+const char* EventTypeName(EventType type);
+std::optional<EventType> EventTypeFromName(const std::string& name);
+std::optional<EventEncoding> EventEncodingFromName(const std::string& name);
+
+flutter::EncodableValue EncodeEvent(EventEncoding encoding, int32_t browser_id, EventType type,
+                                    const flutter::EncodableValue& value);
+
+// Fixed-layout events, they never build an intermediate map in compact mode.
+flutter::EncodableValue EncodeCursorChanged(EventEncoding encoding, int32_t browser_id, int32_t cursor_type);
+flutter::EncodableValue EncodeLoadingProgressChanged(EventEncoding encoding, int32_t browser_id, double progress);
+flutter::EncodableValue EncodeScrollOffsetChanged(EventEncoding encoding, int32_t browser_id, double x, double y);
+flutter::EncodableValue EncodeIMEComposionPositionChanged(EventEncoding encoding, int32_t browser_id,
+                                                          int32_t x, int32_t y);
+
+struct DecodedEvent {
+    EventType type;
+    int32_t browser_id;
+    // The value as it is carried in map mode.
+    flutter::EncodableValue value;
+};
+
+// Decodes an event of any encoding, mirrors the Dart side decoder.
+std::optional<DecodedEvent> DecodeEvent(const flutter::EncodableValue& event);
+
+} // namespace event_codec
+
+#endif  // COMMON_EVENT_CODEC_H_
@@ -0,0 +1,52 @@
+#include "ipc.h"
+
+#include "include/cef_shared_process_message_builder.h"
+
+#include <cstring>
+
+namespace ipc
+{
+
+CefRefPtr<CefProcessMessage> CreateSharedMessage(const CefString& name, int32_t browser_id, int32_t id,
+                                                 SharedPayloadType type, const void* data, size_t size) {
+    if (size > UINT32_MAX) return nullptr;
+
+    auto builder = CefSharedProcessMessageBuilder::Create(name, sizeof(SharedMessageHeader) + size);
+    if (!builder || !builder->IsValid()) return nullptr;
+
+    auto header = static_cast<SharedMessageHeader*>(builder->Memory());
+    *header = {};
+    header->payload_type = type;
+    header->browser_id = browser_id;
+    header->id = id;
+    header->payload_size = static_cast<uint32_t>(size);
+    std::memcpy(header + 1, data, size);
+    return builder->Build();
+}
+
+const SharedMessageHeader* GetSharedMessageHeader(CefRefPtr<CefSharedMemoryRegion> region) {
+    if (!region || !region->IsValid() || region->Size() < sizeof(SharedMessageHeader)) return nullptr;
+
+    auto header = static_cast<const SharedMessageHeader*>(region->Memory());
+    if (header->payload_size > region->Size() - sizeof(SharedMessageHeader)) return nullptr;
+    return header;
+}
+
+bool ReadEvaluateJavaScriptRequest(CefRefPtr<CefProcessMessage> message, int* message_id, CefString* code) {
+    if (auto region = message->GetSharedMemoryRegion()) {
+        auto header = GetSharedMessageHeader(region);
+        if (!header || header->payload_type != SharedPayloadType::String) return false;
+
+        *message_id = header->id;
+        cef_string_from_utf8(reinterpret_cast<const char*>(header + 1), header->payload_size,
+                             code->GetWritableStruct());
+        return true;
+    }
+
+    auto args = message->GetArgumentList();
+    *message_id = args->GetInt(indexID);
+    *code = args->GetString(1);
+    return true;
+}
+
+} // namespace ipc
@@ -0,0 +1,128 @@
+#ifndef COMMON_IPC_H_
+#define COMMON_IPC_H_
+#pragma once
+
+// Process messages shared by the browser and the renderer processes. Nothing
+// here depends on Flutter, the helper executable builds the renderer side
+// from it alone.
+
+#include "include/cef_base.h"
+#include "include/cef_process_message.h"
+#include "include/cef_shared_memory_region.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ipc
+{
+    const char EvaluateJavaScriptRequest[] = "EvaluateJavaScriptRequest";
+    const char EvaluateJavaScriptResponse[] = "EvaluateJavaScriptResponse";
+    const char EvaluateJavaScriptBatchRequest[] = "EvaluateJavaScriptBatchRequest";
+    const char EvaluateJavaScriptBatchResponse[] = "EvaluateJavaScriptBatchResponse";
+    const char RegisterScriptRequest[] = "RegisterScriptRequest";
+    const char UnregisterScriptRequest[] = "UnregisterScriptRequest";
+    // Answered with an EvaluateJavaScriptResponse.
+    const char InvokeScriptRequest[] = "InvokeScriptRequest";
+
+    // Sent by flutterHost.postMessage, carries the converted value only.
+    const char HostMessage[] = "HostMessage";
+    const size_t indexHostMessageValue = 0;
+
+    // Sent by postMessageToPage, the renderer answers every one with a
+    // PageMessageAck once the listener returned.
+    const char PageMessage[] = "PageMessage";
+    const char PageMessageAck[] = "PageMessageAck";
+    const size_t indexPageMessageValue = 0;
+    // Page messages sent but not acknowledged yet, later ones wait in the
+    // browser process where they can still be coalesced.
+    const int kPageMessageWindow = 4;
+
+    // Sent once per user script, the renderer keeps them and runs them in
+    // every new V8 context of the browser without further messages.
+    const char AddUserScript[] = "AddUserScript";
+    const char RemoveUserScript[] = "RemoveUserScript";
+    const size_t indexUserScriptID = 0;
+    const size_t indexUserScriptSource = 1;
+    const size_t indexUserScriptInjectionTime = 2;
+    const size_t indexUserScriptAllFrames = 3;
+
+    enum class UserScriptInjectionTime : int {
+        DocumentStart = 0,
+        DOMContentLoaded = 1,
+    };
+
+    // Keys of the CreateBrowser extra info, lists of the argument lists of
+    // the AddUserScript and RegisterScriptRequest messages. A renderer process
+    // gets it before the first page of the browser runs, a cross-process
+    // navigation included.
+    const char extraInfoUserScripts[] = "UserScripts";
+    const char extraInfoRegisteredScripts[] = "RegisteredScripts";
+    // Sent by a renderer process when it gets a browser, the browser process
+    // answers with the scripts added after the browser was created.
+    const char UserScriptsRequest[] = "UserScriptsRequest";
+
+    // The id Dart knows the browser by, the renderer writes it into the
+    // header of its shared memory messages. Comes with the extra info, and
+    // with a SetControllerID message whenever a pooled browser changes hands.
+    const char extraInfoControllerID[] = "ControllerID";
+    const char SetControllerID[] = "SetControllerID";
+    const size_t indexControllerID = 0;
+
+    // CefProcessMessage argument position
+    const size_t indexID = 0; // message id
+    const size_t indexSuccessFlag = 1;
+    const size_t indexCustom = 2;
+
+    // Payloads from this size on travel in a shared memory region instead of
+    // an argument list, which saves the serialization copies.
+    const size_t kSharedMemoryThreshold = 64 * 1024;
+
+    enum class SharedPayloadType : uint8_t {
+        String = 0, // UTF-8
+        Binary = 1,
+        HostMessage = 0x80, // flutterHost.postMessage
+    };
+
+    // Start of a shared memory message region, the payload follows it. The
+    // layout is the one of the Dart payload channel, so the browser process
+    // forwards a region from the renderer as it is.
+    struct SharedMessageHeader {
+        SharedPayloadType payload_type;
+        uint8_t padding[3];
+        int32_t browser_id; // controller id, see SetControllerID
+        int32_t id;
+        uint32_t payload_size;
+    };
+    static_assert(sizeof(SharedMessageHeader) == 16, "the Dart side reads a 16 byte header");
+
+    // Returns nullptr if the region cannot be allocated, callers fall back to
+    // an argument list.
+    CefRefPtr<CefProcessMessage> CreateSharedMessage(const CefString& name, int32_t browser_id, int32_t id,
+                                                     SharedPayloadType type, const void* data, size_t size);
+    // Returns nullptr if |region| is too small for the header and its payload.
+    const SharedMessageHeader* GetSharedMessageHeader(CefRefPtr<CefSharedMemoryRegion> region);
+
+    // EvaluateJavaScriptResponse of a script that threw, the error message
+    // is at indexCustom.
+    const char EvaluateErrorMessage[] = "Evaluate Error";
+    const size_t indexEvalError = indexCustom + 1;
+    const size_t indexScriptResourceName = indexCustom + 2;
+    const size_t indexSourceLine = indexCustom + 3;
+    const size_t indexLineNumber = indexCustom + 4;
+    const size_t indexStartColumn = indexCustom + 5;
+
+    // Large code is sent in shared memory, this reads both forms of an
+    // EvaluateJavaScriptRequest.
+    bool ReadEvaluateJavaScriptRequest(CefRefPtr<CefProcessMessage> message, int* message_id, CefString* code);
+
+    // EvaluateJavaScriptBatchRequest and response.
+    const size_t indexBatchScripts = 1;
+    const size_t indexBatchResults = 1;
+
+    // RegisterScriptRequest, UnregisterScriptRequest and InvokeScriptRequest.
+    const size_t indexScriptHandle = 1;
+    const size_t indexScriptSource = 2;
+    const size_t indexScriptArguments = 2;
+}
+
+#endif  // COMMON_IPC_H_
@@ -1,25 +1,43 @@
 #include "message.h"
 #include "flutter/encodable_value.h"
+#include "util.h"
+#include <cstring>
 #include <iostream>
+#include <limits>
 
 namespace
 {
     const std::string keyID = "_id_";
     const std::string keyResult = "_result_";
     const std::string keyError = "_error_";
+    const std::string keyIDs = "_ids_";
+    const std::string keyTimeout = "timeout";
 
+    // Returns false if |key| is missing or not an int. The codec sends Dart
+    // ints beyond 32 bits as int64, those in range are accepted.
     bool GetInt(const flutter::EncodableMap* m, const std::string key, int* v) {
         auto it = m->find(key);
-        if (it != m->end()) {
-            *v = std::get<std::int32_t>(it->second);
+        if (it == m->end()) return false;
+
+        if (const auto i = std::get_if<std::int32_t>(&it->second)) {
+            *v = *i;
             return true;
         }
+        const auto l = std::get_if<std::int64_t>(&it->second);
+        if (!l || *l < std::numeric_limits<int>::min() || *l > std::numeric_limits<int>::max()) return false;
+        *v = static_cast<int>(*l);
+        return true;
+    }
 
-        return false;
+    // A call is refused rather than sent without the timeout it asked for.
+    bool HasValidTimeout(const flutter::EncodableMap* m) {
+        auto it = m->find(keyTimeout);
+        int timeout = 0;
+        return it == m->end() || it->second.IsNull() || GetInt(m, keyTimeout, &timeout);
     }
 
     // Returns 0 if id not found or invalid.
-    int GetMessageID(const flutter::EncodableMap* m) {
+    int GetMessageIDFromMap(const flutter::EncodableMap* m) {
         int id = 0;
         if (GetInt(m, keyID, &id)) {
             return id;
@@ -28,37 +46,100 @@ namespace
         return 0;
     }
 
-    CefString GetCefString(const flutter::EncodableMap* m, const std::string key) {
-        CefString ret;
+    // Reads an Eval outcome written from |success_index| on, the indices are
+    // those of the EvaluateJavaScript response shifted accordingly.
+    void InsertEvaluateResult(flutter::EncodableMap& m, CefRefPtr<CefListValue> args, size_t success_index) {
+        const auto index = [success_index](size_t i) { return i - ipc::indexSuccessFlag + success_index; };
 
-        auto it = m->find(key);
-        if (it != m->end()) {
-            auto s = std::get<std::string>(it->second);
-            ret = CefString(s);
+        const auto err_or_result_flag = index(ipc::indexCustom);
+        if (args->GetBool(success_index)) {
+            m.insert({
+                flutter::EncodableValue(keyResult),
+                util::CefValueToEncodableValue(args->GetValue(err_or_result_flag)),
+            });
+            return;
         }
 
-        return ret;
+        auto error_msg = args->GetString(err_or_result_flag);
+        m.insert({
+            flutter::EncodableValue(keyError),
+            flutter::EncodableValue(error_msg.ToString()),
+        });
+        if (error_msg == ipc::EvaluateErrorMessage) {
+            m.insert({
+                flutter::EncodableValue("message"),
+                flutter::EncodableValue(args->GetString(index(ipc::indexEvalError)).ToString()),
+            });
+            m.insert({
+                flutter::EncodableValue("file"),
+                flutter::EncodableValue(args->GetString(index(ipc::indexScriptResourceName)).ToString()),
+            });
+            m.insert({
+                flutter::EncodableValue("sourceLine"),
+                flutter::EncodableValue(args->GetString(index(ipc::indexSourceLine)).ToString()),
+            });
+            m.insert({
+                flutter::EncodableValue("line"),
+                flutter::EncodableValue(args->GetInt(index(ipc::indexLineNumber))),
+            });
+            m.insert({
+                flutter::EncodableValue("column"),
+                flutter::EncodableValue(args->GetInt(index(ipc::indexStartColumn))),
+            });
+        }
     }
 }
 
 namespace async_channel_message
 {
 
+int GetMessageID(const flutter::EncodableValue* v) {
+    const auto m = std::get_if<flutter::EncodableMap>(v);
+    return m ? GetMessageIDFromMap(m) : 0;
+}
+
+std::optional<int> GetTimeout(const flutter::EncodableValue* v) {
+    const auto m = std::get_if<flutter::EncodableMap>(v);
+    int timeout = 0;
+    if (!m || !GetInt(m, keyTimeout, &timeout) || timeout <= 0) return std::nullopt;
+    return timeout;
+}
+
+flutter::EncodableValue CreateFailureMessage(const std::vector<int>& ids, const std::string& error) {
+    flutter::EncodableList list;
+    list.reserve(ids.size());
+    for (const auto id : ids) {
+        list.push_back(flutter::EncodableValue(id));
+    }
+
+    return flutter::EncodableValue(flutter::EncodableMap{
+        {flutter::EncodableValue(keyIDs), flutter::EncodableValue(std::move(list))},
+        {flutter::EncodableValue(keyError), flutter::EncodableValue(error)},
+    });
+}
+
 CefRefPtr<CefProcessMessage> EvaluateJavaScript::CreateCefProcessMessage(const flutter::EncodableValue* v) {
     const flutter::EncodableMap* m =
         std::get_if<flutter::EncodableMap>(v);
     if (!m) return nullptr;
 
-    auto message_id = GetMessageID(m);
-    if (message_id == 0) return nullptr;
+    auto message_id = GetMessageIDFromMap(m);
+    if (message_id == 0 || !HasValidTimeout(m)) return nullptr;
+
+    auto it = m->find(flutter::EncodableValue("code"));
+    const auto code = it != m->end() ? std::get_if<std::string>(&it->second) : nullptr;
+    if (!code || code->empty()) return nullptr;
 
-    auto code = GetCefString(m, "code");
-    if (code.empty()) return nullptr;
+    if (code->size() >= ipc::kSharedMemoryThreshold) {
+        auto msg = ipc::CreateSharedMessage(ipc::EvaluateJavaScriptRequest, 0, message_id,
+                                            ipc::SharedPayloadType::String, code->data(), code->size());
+        if (msg) return msg;
+    }
 
     auto msg = CefProcessMessage::Create(ipc::EvaluateJavaScriptRequest);
     auto args = msg->GetArgumentList();
     args->SetInt(0, message_id);
-    args->SetString(1, code);
+    args->SetString(1, *code);
 
     return msg;
 }
@@ -72,46 +153,110 @@ flutter::EncodableValue EvaluateJavaScript::CreateFlutterChannelMessage(
     auto m = flutter::EncodableMap{
         {flutter::EncodableValue(keyID), flutter::EncodableValue(message_id)},
     };
+    InsertEvaluateResult(m, args, ipc::indexSuccessFlag);
 
-    auto success = args->GetBool(ipc::indexSuccessFlag);
-    const auto err_or_result_flag = ipc::indexCustom;
-    if (success) {
-        m.insert({
-            flutter::EncodableValue(keyResult),
-            flutter::EncodableValue(args->GetString(err_or_result_flag).ToString()),
-        });
-    } else {
-        auto error_msg = args->GetString(err_or_result_flag);
+    return flutter::EncodableValue(m);
+}
 
-        m.insert({
-            flutter::EncodableValue(keyError),
-            flutter::EncodableValue(error_msg.ToString()),
-        });
-        if (error_msg == EvaluateErrorMessage) {
-            m.insert({
-                flutter::EncodableValue("message"),
-                flutter::EncodableValue(args->GetString(indexEvalError).ToString()),
-            });
-            m.insert({
-                flutter::EncodableValue("file"),
-                flutter::EncodableValue(args->GetString(indexScriptResourceName).ToString()),
-            });
-            m.insert({
-                flutter::EncodableValue("sourceLine"),
-                flutter::EncodableValue(args->GetString(indexSourceLine).ToString()),
-            });
-            m.insert({
-                flutter::EncodableValue("line"),
-                flutter::EncodableValue(args->GetInt(indexLineNumber)),
-            });
-            m.insert({
-                flutter::EncodableValue("column"),
-                flutter::EncodableValue(args->GetInt(indexStartColumn)),
-            });
+CefRefPtr<CefProcessMessage> EvaluateJavaScriptBatch::CreateCefProcessMessage(const flutter::EncodableValue* v) {
+    const flutter::EncodableMap* m =
+        std::get_if<flutter::EncodableMap>(v);
+    if (!m) return nullptr;
+
+    auto message_id = GetMessageIDFromMap(m);
+    if (message_id == 0 || !HasValidTimeout(m)) return nullptr;
+
+    auto it = m->find(flutter::EncodableValue("scripts"));
+    const auto scripts = it != m->end() ? std::get_if<flutter::EncodableList>(&it->second) : nullptr;
+    if (!scripts) return nullptr;
+
+    auto list = CefListValue::Create();
+    list->SetSize(scripts->size());
+    for (size_t i = 0; i < scripts->size(); i++) {
+        const auto code = std::get_if<std::string>(&(*scripts)[i]);
+        if (!code) return nullptr;
+        list->SetString(i, *code);
+    }
+
+    auto msg = CefProcessMessage::Create(ipc::EvaluateJavaScriptBatchRequest);
+    auto args = msg->GetArgumentList();
+    args->SetInt(ipc::indexID, message_id);
+    args->SetList(ipc::indexBatchScripts, list);
+
+    return msg;
+}
+
+flutter::EncodableValue EvaluateJavaScriptBatch::CreateFlutterChannelMessage(
+    CefRefPtr<CefProcessMessage> cpm) {
+
+    auto args = cpm->GetArgumentList();
+    auto message_id = args->GetInt(ipc::indexID);
+    auto list = args->GetList(ipc::indexBatchResults);
+
+    flutter::EncodableList results;
+    const auto size = list ? list->GetSize() : 0;
+    results.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        flutter::EncodableMap result;
+        InsertEvaluateResult(result, list->GetList(i), 0);
+        results.push_back(flutter::EncodableValue(std::move(result)));
+    }
+
+    return flutter::EncodableValue(flutter::EncodableMap{
+        {flutter::EncodableValue(keyID), flutter::EncodableValue(message_id)},
+        {flutter::EncodableValue(keyResult), flutter::EncodableValue(std::move(results))},
+    });
+}
+
+CefRefPtr<CefProcessMessage> InvokeScript::CreateRegisterMessage(int handle, const std::string& source) {
+    auto msg = CefProcessMessage::Create(ipc::RegisterScriptRequest);
+    auto args = msg->GetArgumentList();
+    args->SetInt(ipc::indexID, 0);
+    args->SetInt(ipc::indexScriptHandle, handle);
+    args->SetString(ipc::indexScriptSource, source);
+
+    return msg;
+}
+
+CefRefPtr<CefProcessMessage> InvokeScript::CreateUnregisterMessage(int handle) {
+    auto msg = CefProcessMessage::Create(ipc::UnregisterScriptRequest);
+    auto args = msg->GetArgumentList();
+    args->SetInt(ipc::indexID, 0);
+    args->SetInt(ipc::indexScriptHandle, handle);
+
+    return msg;
+}
+
+CefRefPtr<CefProcessMessage> InvokeScript::CreateCefProcessMessage(const flutter::EncodableValue* v) {
+    const flutter::EncodableMap* m =
+        std::get_if<flutter::EncodableMap>(v);
+    if (!m) return nullptr;
+
+    auto message_id = GetMessageIDFromMap(m);
+    if (message_id == 0 || !HasValidTimeout(m)) return nullptr;
+
+    int handle = 0;
+    if (!GetInt(m, "handle", &handle)) return nullptr;
+
+    auto list = CefListValue::Create();
+    auto it = m->find(flutter::EncodableValue("arguments"));
+    if (it != m->end() && !it->second.IsNull()) {
+        const auto arguments = std::get_if<flutter::EncodableList>(&it->second);
+        if (!arguments) return nullptr;
+
+        list->SetSize(arguments->size());
+        for (size_t i = 0; i < arguments->size(); i++) {
+            list->SetValue(i, util::EncodableValueToCefValue((*arguments)[i]));
         }
     }
 
-    return flutter::EncodableValue(m);
+    auto msg = CefProcessMessage::Create(ipc::InvokeScriptRequest);
+    auto args = msg->GetArgumentList();
+    args->SetInt(ipc::indexID, message_id);
+    args->SetInt(ipc::indexScriptHandle, handle);
+    args->SetList(ipc::indexScriptArguments, list);
+
+    return msg;
 }
 
 } // namespace async_channel_message
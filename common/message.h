@@ -6,33 +6,55 @@
 #include "include/cef_process_message.h"
 #include <flutter/standard_method_codec.h>
 
-namespace ipc
-{
-    const CefString EvaluateJavaScriptRequest = "EvaluateJavaScriptRequest";
-    const CefString EvaluateJavaScriptResponse = "EvaluateJavaScriptResponse";
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
 
-    // CefProcessMessage argument position
-    const size_t indexID = 0; // message id
-    const size_t indexSuccessFlag = 1;
-    const size_t indexCustom = 2;
-}
+#include "ipc.h"
 
 namespace async_channel_message
 {
 
+// Errors of calls that never got their response.
+const char kErrorTimedOut[] = "Evaluation timed out";
+const char kErrorCanceled[] = "Evaluation canceled";
+const char kErrorRenderProcessTerminated[] = "Render process terminated";
+const char kErrorBrowserClosed[] = "Browser closed";
+
+// Returns the id of the async channel message |v|, 0 if it has none.
+int GetMessageID(const flutter::EncodableValue* v);
+// Returns the timeout in milliseconds |v| asks for, if any.
+std::optional<int> GetTimeout(const flutter::EncodableValue* v);
+// Fails the calls |ids| with |error| in one message.
+flutter::EncodableValue CreateFailureMessage(const std::vector<int>& ids, const std::string& error);
+
 class EvaluateJavaScript {
 public:
-    static inline const CefString EvaluateErrorMessage = "Evaluate Error";
-    static const size_t indexEvalError = ipc::indexCustom + 1;
-    static const size_t indexScriptResourceName = ipc::indexCustom + 2;
-	static const size_t indexSourceLine = ipc::indexCustom + 3;
-	static const size_t indexLineNumber = ipc::indexCustom + 4;
-	static const size_t indexStartColumn = ipc::indexCustom + 5;
+    // Large code is sent in shared memory, see ipc::ReadEvaluateJavaScriptRequest.
+    static CefRefPtr<CefProcessMessage> CreateCefProcessMessage(const flutter::EncodableValue* v);
+    static flutter::EncodableValue CreateFlutterChannelMessage(CefRefPtr<CefProcessMessage> cpm);
+};
 
+// Runs several scripts with one message pair and one context entry. The
+// response holds a list per script, laid out like the EvaluateJavaScript
+// response from ipc::indexSuccessFlag on.
+class EvaluateJavaScriptBatch {
+public:
     static CefRefPtr<CefProcessMessage> CreateCefProcessMessage(const flutter::EncodableValue* v);
     static flutter::EncodableValue CreateFlutterChannelMessage(CefRefPtr<CefProcessMessage> cpm);
 };
 
+// Scripts registered once per browser, the renderer compiles them once per V8
+// context and calls only carry the handle and the arguments. The registration
+// messages use 0 as message id.
+class InvokeScript {
+public:
+    static CefRefPtr<CefProcessMessage> CreateRegisterMessage(int handle, const std::string& source);
+    static CefRefPtr<CefProcessMessage> CreateUnregisterMessage(int handle);
+    static CefRefPtr<CefProcessMessage> CreateCefProcessMessage(const flutter::EncodableValue* v);
+};
+
 } // namespace async_channel_message
 
 #endif  // COMMON_MESSAGE_H_
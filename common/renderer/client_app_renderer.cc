@@ -2,23 +2,237 @@
 // reserved. Use of this source code is governed by a BSD-style license that
 // can be found in the LICENSE file.
 
+#include <algorithm>
+#include <map>
+
 #include "include/cef_parser.h"
 #include "include/base/cef_logging.h"
 #include "client_app_renderer.h"
-#include "message.h"
+#include "ipc.h"
+#include "v8_value_converter.h"
 
-using namespace async_channel_message;
 
 namespace
 {
 
-CefString CefV8ValueToJSON(CefRefPtr<CefV8Context> v8_context, CefRefPtr<CefV8Value> value) {
-    auto json_val = v8_context
-        ->GetGlobal()
-        ->GetValue("JSON")
-        ->GetValue("stringify")
-        ->ExecuteFunction(nullptr, CefV8ValueList{value});
-    return json_val->GetStringValue();
+// Promise based wrappers around the cefQuery functions of the message router,
+// and postMessage which skips the router and its string encoding.
+const char kFlutterHostExtension[] = R"(
+var flutterHost;
+if (!flutterHost) flutterHost = {};
+(function() {
+  function toError(code, message) {
+    var error = new Error(message);
+    error.code = code;
+    return error;
+  }
+
+  // Resolves with the string the Dart handler returns.
+  flutterHost.invoke = function(request) {
+    return new Promise(function(resolve, reject) {
+      window.cefQuery({
+        request: String(request),
+        onSuccess: resolve,
+        onFailure: function(code, message) { reject(toError(code, message)); }
+      });
+    });
+  };
+
+  // Calls onResponse for every response of a persistent query until Dart
+  // fails it or the returned function cancels it.
+  flutterHost.subscribe = function(request, onResponse, onError) {
+    var id = window.cefQuery({
+      request: String(request),
+      persistent: true,
+      onSuccess: onResponse,
+      onFailure: function(code, message) { if (onError) onError(toError(code, message)); }
+    });
+    return function() { window.cefQueryCancel(id); };
+  };
+
+  // Set flutterHost.onmessage to receive the values sent with
+  // WebViewController.postMessageToPage.
+  flutterHost.onmessage = null;
+
+  // Sends |value| to WebViewController.onHostMessage without waiting for an
+  // answer. An ArrayBuffer or typed array |value| that is listed in
+  // |transfer|, or large, travels in shared memory and reaches Dart as raw
+  // bytes. Buffers are not detached, the page keeps its copy.
+  flutterHost.postMessage = function(value, transfer) {
+    native function PostMessage();
+    PostMessage(value, transfer);
+  };
+})();
+)";
+
+// Controller ids by browser identifier, see ipc::SetControllerID. Only used on
+// the renderer main thread.
+std::map<int, int> controller_ids;
+
+int ControllerID(CefRefPtr<CefBrowser> browser) {
+	auto it = browser ? controller_ids.find(browser->GetIdentifier()) : controller_ids.end();
+	return it != controller_ids.end() ? it->second : 0;
+}
+
+// Native side of the flutterHost extension.
+class FlutterHostHandler : public CefV8Handler {
+public:
+	FlutterHostHandler() {}
+
+	bool Execute(const CefString& name,
+				 CefRefPtr<CefV8Value> object,
+				 const CefV8ValueList& arguments,
+				 CefRefPtr<CefV8Value>& retval,
+				 CefString& exception) override {
+		if (name != "PostMessage") return false;
+
+		auto context = CefV8Context::GetCurrentContext();
+		auto frame = context ? context->GetFrame() : nullptr;
+		if (!frame) {
+			exception = "flutterHost is not available in this context";
+			return true;
+		}
+
+		auto v8_value = arguments.empty() ? CefV8Value::CreateUndefined() : arguments[0];
+		auto transfer = arguments.size() > 1 ? arguments[1] : nullptr;
+		const auto view = v8_value_converter::GetBinaryView(context, v8_value);
+		if (view && (view->size >= ipc::kSharedMemoryThreshold || IsTransferred(v8_value, transfer))) {
+			auto message = ipc::CreateSharedMessage(ipc::HostMessage, ControllerID(frame->GetBrowser()), 0,
+													ipc::SharedPayloadType::HostMessage, view->data, view->size);
+			if (message) {
+				frame->SendProcessMessage(PID_BROWSER, message);
+				return true;
+			}
+		}
+
+		std::string error;
+		auto value = v8_value_converter::ToCefValue(context, v8_value, &error);
+		if (!value) {
+			exception = error;
+			return true;
+		}
+
+		auto message = CefProcessMessage::Create(ipc::HostMessage);
+		message->GetArgumentList()->SetValue(ipc::indexHostMessageValue, value);
+		frame->SendProcessMessage(PID_BROWSER, message);
+		return true;
+	}
+
+private:
+	// Returns true if |value|, or the buffer it views, is in the |transfer| array.
+	static bool IsTransferred(CefRefPtr<CefV8Value> value, CefRefPtr<CefV8Value> transfer) {
+		if (!transfer || !transfer->IsArray()) return false;
+
+		auto buffer = value->IsArrayBuffer() ? value : value->GetValue("buffer");
+		for (int i = 0; i < transfer->GetArrayLength(); i++) {
+			auto item = transfer->GetValue(i);
+			if (item && (item->IsSame(value) || (buffer && item->IsSame(buffer)))) return true;
+		}
+		return false;
+	}
+
+	IMPLEMENT_REFCOUNTING(FlutterHostHandler);
+	DISALLOW_COPY_AND_ASSIGN(FlutterHostHandler);
+};
+
+// Large string and binary results skip the argument list and its copies.
+CefRefPtr<CefProcessMessage> CreateSharedResponse(int message_id,
+                                                  CefRefPtr<CefV8Context> v8_context,
+                                                  CefRefPtr<CefV8Value> value) {
+    if (value->IsString()) {
+        // UTF-8 takes at least one byte per UTF-16 unit.
+        const auto str = value->GetStringValue();
+        if (str.length() < ipc::kSharedMemoryThreshold) return nullptr;
+
+        const auto utf8 = str.ToString();
+        return ipc::CreateSharedMessage(ipc::EvaluateJavaScriptResponse, ControllerID(v8_context->GetBrowser()),
+                                        message_id, ipc::SharedPayloadType::String, utf8.data(), utf8.size());
+    }
+
+    const auto view = v8_value_converter::GetBinaryView(v8_context, value);
+    if (!view || view->size < ipc::kSharedMemoryThreshold) return nullptr;
+
+    return ipc::CreateSharedMessage(ipc::EvaluateJavaScriptResponse, ControllerID(v8_context->GetBrowser()),
+                                    message_id, ipc::SharedPayloadType::Binary, view->data, view->size);
+}
+
+// Writes the outcome of one Eval from |success_index| on, in the layout of the
+// EvaluateJavaScript response.
+void WriteEvaluateResult(CefRefPtr<CefListValue> args,
+                         size_t success_index,
+                         CefRefPtr<CefV8Context> v8_context,
+                         bool success,
+                         CefRefPtr<CefV8Value> retval,
+                         CefRefPtr<CefV8Exception> exception) {
+	const auto index = [success_index](size_t i) { return i - ipc::indexSuccessFlag + success_index; };
+	const auto err_or_result_flag = index(ipc::indexCustom);
+
+	args->SetBool(success_index, false);
+	if (success) {
+		std::string error;
+		auto result = v8_value_converter::ToCefValue(v8_context, retval, &error);
+		if (result) {
+			args->SetBool(success_index, true);
+			args->SetValue(err_or_result_flag, result);
+		} else {
+			args->SetString(err_or_result_flag, error);
+		}
+	} else {
+		args->SetString(err_or_result_flag, ipc::EvaluateErrorMessage);
+		args->SetString(index(ipc::indexEvalError), exception->GetMessageW());
+		args->SetString(index(ipc::indexScriptResourceName), exception->GetScriptResourceName());
+		args->SetString(index(ipc::indexSourceLine), exception->GetSourceLine());
+		args->SetInt(index(ipc::indexLineNumber), exception->GetLineNumber());
+		args->SetInt(index(ipc::indexStartColumn), exception->GetStartColumn());
+	}
+}
+
+// Runs the DOMContentLoaded user scripts of one context.
+class UserScriptRunner : public CefV8Handler {
+public:
+	explicit UserScriptRunner(std::vector<std::pair<CefString, CefString>> scripts)
+		: scripts_(std::move(scripts)) {}
+
+	bool Execute(const CefString& name,
+				 CefRefPtr<CefV8Value> object,
+				 const CefV8ValueList& arguments,
+				 CefRefPtr<CefV8Value>& retval,
+				 CefString& exception) override {
+		auto context = CefV8Context::GetCurrentContext();
+		for (const auto& [script_name, source] : scripts_) {
+			CefRefPtr<CefV8Value> result;
+			CefRefPtr<CefV8Exception> error;
+			context->Eval(source, script_name, 0, result, error);
+		}
+		scripts_.clear();
+		return true;
+	}
+
+private:
+	// Resource name and source of every script.
+	std::vector<std::pair<CefString, CefString>> scripts_;
+
+	IMPLEMENT_REFCOUNTING(UserScriptRunner);
+	DISALLOW_COPY_AND_ASSIGN(UserScriptRunner);
+};
+
+// Returns the EvaluateJavaScriptResponse for the outcome of one call.
+CefRefPtr<CefProcessMessage> CreateEvaluateResponse(int message_id,
+                                                    CefRefPtr<CefV8Context> v8_context,
+                                                    bool success,
+                                                    CefRefPtr<CefV8Value> retval,
+                                                    CefRefPtr<CefV8Exception> exception) {
+	if (success) {
+		if (auto shared_msg = CreateSharedResponse(message_id, v8_context, retval)) {
+			return shared_msg;
+		}
+	}
+
+	auto response_msg = CefProcessMessage::Create(ipc::EvaluateJavaScriptResponse);
+	auto response_args = response_msg->GetArgumentList();
+	response_args->SetInt(ipc::indexID, message_id);
+	WriteEvaluateResult(response_args, ipc::indexSuccessFlag, v8_context, success, retval, exception);
+	return response_msg;
 }
 
 }
@@ -29,12 +243,38 @@ void ClientAppRenderer::OnWebKitInitialized() {
 	// Create the renderer-side router for query handling.
 	CefMessageRouterConfig config;
 	message_router_ = CefMessageRouterRendererSide::Create(config);
+
+	CefRegisterExtension("v8/flutterHost", kFlutterHostExtension, new FlutterHostHandler());
 }
 
-// void ClientAppRenderer::OnBrowserCreated(CefRefPtr<CefBrowser> browser,
-//     									 CefRefPtr<CefDictionaryValue> extra_info) {}
+void ClientAppRenderer::OnBrowserCreated(CefRefPtr<CefBrowser> browser,
+										 CefRefPtr<CefDictionaryValue> extra_info) {
+	// Messages sent to an earlier renderer process of the browser never
+	// arrive here, the scripts come with the extra info instead.
+	const auto browser_id = browser->GetIdentifier();
+	if (extra_info) {
+		controller_ids[browser_id] = extra_info->GetInt(ipc::extraInfoControllerID);
+		auto user_scripts = extra_info->GetList(ipc::extraInfoUserScripts);
+		for (size_t i = 0; user_scripts && i < user_scripts->GetSize(); i++) {
+			this->addUserScript(browser_id, user_scripts->GetList(i));
+		}
+		auto registered_scripts = extra_info->GetList(ipc::extraInfoRegisteredScripts);
+		for (size_t i = 0; registered_scripts && i < registered_scripts->GetSize(); i++) {
+			this->registerScript(browser_id, registered_scripts->GetList(i));
+		}
+	}
+
+	// Scripts added since the browser was created.
+	if (auto frame = browser->GetMainFrame()) {
+		frame->SendProcessMessage(PID_BROWSER, CefProcessMessage::Create(ipc::UserScriptsRequest));
+	}
+}
 
-// void ClientAppRenderer::OnBrowserDestroyed(CefRefPtr<CefBrowser> browser) {}
+void ClientAppRenderer::OnBrowserDestroyed(CefRefPtr<CefBrowser> browser) {
+	controller_ids.erase(browser->GetIdentifier());
+	script_sources_.erase(browser->GetIdentifier());
+	user_scripts_.erase(browser->GetIdentifier());
+}
 
 // CefRefPtr<CefLoadHandler> ClientAppRenderer::GetLoadHandler() {}
 
@@ -42,12 +282,18 @@ void ClientAppRenderer::OnContextCreated(CefRefPtr<CefBrowser> browser,
                                          CefRefPtr<CefFrame> frame,
                                          CefRefPtr<CefV8Context> context) {
 	message_router_->OnContextCreated(browser, frame, context);
+	runUserScripts(browser, frame, context);
 }
 
 void ClientAppRenderer::OnContextReleased(CefRefPtr<CefBrowser> browser,
                          CefRefPtr<CefFrame> frame,
                          CefRefPtr<CefV8Context> context) {
 	message_router_->OnContextReleased(browser, frame, context);
+
+	compiled_scripts_.erase(
+		std::remove_if(compiled_scripts_.begin(), compiled_scripts_.end(),
+					   [&context](const CompiledScripts& c) { return c.context->IsSame(context); }),
+		compiled_scripts_.end());
 }
 
 // void ClientAppRenderer::OnUncaughtException(CefRefPtr<CefBrowser> browser,
@@ -71,6 +317,38 @@ bool ClientAppRenderer::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
 		this->evaluateJavaScript(browser, frame, source_process, message);
         return true;
     }
+    if (message_name == ipc::EvaluateJavaScriptBatchRequest) {
+		this->evaluateJavaScriptBatch(browser, frame, message);
+        return true;
+    }
+    if (message_name == ipc::PageMessage) {
+		this->deliverPageMessage(frame, message);
+        return true;
+    }
+    if (message_name == ipc::SetControllerID) {
+		controller_ids[browser->GetIdentifier()] = message->GetArgumentList()->GetInt(ipc::indexControllerID);
+        return true;
+    }
+    if (message_name == ipc::AddUserScript) {
+		this->addUserScript(browser->GetIdentifier(), message->GetArgumentList());
+        return true;
+    }
+    if (message_name == ipc::RemoveUserScript) {
+		this->removeUserScript(browser, message);
+        return true;
+    }
+    if (message_name == ipc::RegisterScriptRequest) {
+		this->registerScript(browser->GetIdentifier(), message->GetArgumentList());
+        return true;
+    }
+    if (message_name == ipc::UnregisterScriptRequest) {
+		this->unregisterScript(browser, message);
+        return true;
+    }
+    if (message_name == ipc::InvokeScriptRequest) {
+		this->invokeScript(browser, frame, message);
+        return true;
+    }
 
 	return this->message_router_->OnProcessMessageReceived(browser, frame,
             source_process, message);
@@ -85,11 +363,19 @@ void ClientAppRenderer::evaluateJavaScript(CefRefPtr<CefBrowser> browser,
     auto const v8_context = frame->GetV8Context();
 	auto response_msg = CefProcessMessage::Create(ipc::EvaluateJavaScriptResponse);
 	auto response_args = response_msg->GetArgumentList();
-	auto args = message->GetArgumentList();
-	response_args->SetInt(ipc::indexID, args->GetInt(ipc::indexID));
+	int message_id = 0;
+	CefString code;
+	const auto valid_request = ipc::ReadEvaluateJavaScriptRequest(message, &message_id, &code);
+	response_args->SetInt(ipc::indexID, message_id);
 	response_args->SetBool(ipc::indexSuccessFlag, false);
 
 	constexpr auto err_or_result_flag = ipc::indexCustom + 0;
+    if (!valid_request) {
+		response_args->SetString(err_or_result_flag, "Invalid request");
+		browser->GetMainFrame()->SendProcessMessage(PID_BROWSER, response_msg);
+        return;
+    }
+
     if (!v8_context) {
 		response_args->SetString(err_or_result_flag, "Unable to get v8 context");
 		browser->GetMainFrame()->SendProcessMessage(PID_BROWSER, response_msg);
@@ -104,22 +390,234 @@ void ClientAppRenderer::evaluateJavaScript(CefRefPtr<CefBrowser> browser,
 
     CefRefPtr<CefV8Exception> exception;
     CefRefPtr<CefV8Value> retval;
-	auto code = args->GetString(1);
     auto success = v8_context->Eval(code, frame->GetURL(), 0, retval, exception);
-    if (success) {
-		response_args->SetBool(ipc::indexSuccessFlag, true);
-        if (retval->IsValid()) {
-            response_args->SetString(err_or_result_flag, CefV8ValueToJSON(v8_context, retval));
-        }
-    } else {
-		response_args->SetString(err_or_result_flag, EvaluateJavaScript::EvaluateErrorMessage);
-		response_args->SetString(EvaluateJavaScript::indexEvalError, exception->GetMessageW());
-		response_args->SetString(EvaluateJavaScript::indexScriptResourceName, exception->GetScriptResourceName());
-		response_args->SetString(EvaluateJavaScript::indexSourceLine, exception->GetSourceLine());
-		response_args->SetInt(EvaluateJavaScript::indexLineNumber, exception->GetLineNumber());
-		response_args->SetInt(EvaluateJavaScript::indexStartColumn, exception->GetStartColumn());
-    }
+	response_msg = CreateEvaluateResponse(message_id, v8_context, success, retval, exception);
 
     v8_context->Exit();
 	browser->GetMainFrame()->SendProcessMessage(PID_BROWSER, response_msg);
 }
+
+void ClientAppRenderer::evaluateJavaScriptBatch(CefRefPtr<CefBrowser> browser,
+												CefRefPtr<CefFrame> frame,
+												CefRefPtr<CefProcessMessage> message) {
+	auto args = message->GetArgumentList();
+	auto scripts = args->GetList(ipc::indexBatchScripts);
+
+	auto response_msg = CefProcessMessage::Create(ipc::EvaluateJavaScriptBatchResponse);
+	auto response_args = response_msg->GetArgumentList();
+	response_args->SetInt(ipc::indexID, args->GetInt(ipc::indexID));
+
+	auto results = CefListValue::Create();
+	const auto size = scripts ? scripts->GetSize() : 0;
+	results->SetSize(size);
+
+	// Every script fails the same way if the context is unusable.
+	auto const v8_context = frame->GetV8Context();
+	const char* context_error = nullptr;
+	if (!v8_context) {
+		context_error = "Unable to get v8 context";
+	} else if (!v8_context->Enter()) {
+		context_error = "Unable to enter v8 context";
+	}
+
+	const auto url = frame->GetURL();
+	for (size_t i = 0; i < size; i++) {
+		auto result = CefListValue::Create();
+		if (context_error) {
+			result->SetBool(0, false);
+			result->SetString(1, context_error);
+		} else {
+			CefRefPtr<CefV8Exception> exception;
+			CefRefPtr<CefV8Value> retval;
+			auto success = v8_context->Eval(scripts->GetString(i), url, 0, retval, exception);
+			WriteEvaluateResult(result, 0, v8_context, success, retval, exception);
+		}
+		results->SetList(i, result);
+	}
+
+	if (!context_error) v8_context->Exit();
+	response_args->SetList(ipc::indexBatchResults, results);
+	browser->GetMainFrame()->SendProcessMessage(PID_BROWSER, response_msg);
+}
+
+void ClientAppRenderer::registerScript(int browser_id, CefRefPtr<CefListValue> args) {
+	const auto handle = args->GetInt(ipc::indexScriptHandle);
+	script_sources_[browser_id][handle] = args->GetString(ipc::indexScriptSource);
+
+	// Registering a handle again replaces its source.
+	for (auto& compiled : compiled_scripts_) {
+		if (compiled.browser_id == browser_id) compiled.functions.erase(handle);
+	}
+}
+
+void ClientAppRenderer::unregisterScript(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message) {
+	const auto browser_id = browser->GetIdentifier();
+	const auto handle = message->GetArgumentList()->GetInt(ipc::indexScriptHandle);
+	auto it = script_sources_.find(browser_id);
+	if (it != script_sources_.end()) it->second.erase(handle);
+
+	for (auto& compiled : compiled_scripts_) {
+		if (compiled.browser_id == browser_id) compiled.functions.erase(handle);
+	}
+}
+
+CefRefPtr<CefV8Value> ClientAppRenderer::getCompiledScript(int browser_id,
+														   CefRefPtr<CefV8Context> context,
+														   int handle,
+														   CefRefPtr<CefV8Exception>& exception,
+														   std::string* error) {
+	auto compiled = std::find_if(compiled_scripts_.begin(), compiled_scripts_.end(),
+								 [&context](const CompiledScripts& c) { return c.context->IsSame(context); });
+	if (compiled != compiled_scripts_.end()) {
+		auto it = compiled->functions.find(handle);
+		if (it != compiled->functions.end()) return it->second;
+	}
+
+	auto sources = script_sources_.find(browser_id);
+	if (sources == script_sources_.end() || !sources->second.count(handle)) {
+		*error = "Script handle not registered";
+		return nullptr;
+	}
+
+	// Parenthesized so function declarations evaluate to the function too.
+	const std::string code = "(" + sources->second[handle].ToString() + "\n)";
+	CefRefPtr<CefV8Value> function;
+	if (!context->Eval(code, "registered-script-" + std::to_string(handle), 0, function, exception)) {
+		return nullptr;
+	}
+	if (!function || !function->IsFunction()) {
+		*error = "Registered script is not a function";
+		return nullptr;
+	}
+
+	if (compiled == compiled_scripts_.end()) {
+		compiled = compiled_scripts_.insert(compiled_scripts_.end(), CompiledScripts{browser_id, context, {}});
+	}
+	compiled->functions[handle] = function;
+	return function;
+}
+
+void ClientAppRenderer::invokeScript(CefRefPtr<CefBrowser> browser,
+									 CefRefPtr<CefFrame> frame,
+									 CefRefPtr<CefProcessMessage> message) {
+	auto args = message->GetArgumentList();
+	const auto message_id = args->GetInt(ipc::indexID);
+
+	auto response_msg = CefProcessMessage::Create(ipc::EvaluateJavaScriptResponse);
+	auto response_args = response_msg->GetArgumentList();
+	response_args->SetInt(ipc::indexID, message_id);
+	response_args->SetBool(ipc::indexSuccessFlag, false);
+
+	constexpr auto err_or_result_flag = ipc::indexCustom + 0;
+	auto const v8_context = frame->GetV8Context();
+	if (!v8_context) {
+		response_args->SetString(err_or_result_flag, "Unable to get v8 context");
+		browser->GetMainFrame()->SendProcessMessage(PID_BROWSER, response_msg);
+		return;
+	}
+
+	if (!v8_context->Enter()) {
+		response_args->SetString(err_or_result_flag, "Unable to enter v8 context");
+		browser->GetMainFrame()->SendProcessMessage(PID_BROWSER, response_msg);
+		return;
+	}
+
+	CefRefPtr<CefV8Exception> exception;
+	std::string error;
+	auto function = getCompiledScript(browser->GetIdentifier(), v8_context,
+									  args->GetInt(ipc::indexScriptHandle), exception, &error);
+	if (!function && !exception) {
+		response_args->SetString(err_or_result_flag, error);
+		v8_context->Exit();
+		browser->GetMainFrame()->SendProcessMessage(PID_BROWSER, response_msg);
+		return;
+	}
+
+	CefRefPtr<CefV8Value> retval;
+	if (function) {
+		CefV8ValueList arguments;
+		auto list = args->GetList(ipc::indexScriptArguments);
+		const auto size = list ? list->GetSize() : 0;
+		for (size_t i = 0; i < size; i++) {
+			arguments.push_back(v8_value_converter::FromCefValue(list->GetValue(i)));
+		}
+
+		retval = function->ExecuteFunction(nullptr, arguments);
+		if (!retval) {
+			exception = function->GetException();
+			function->ClearException();
+		}
+	}
+	response_msg = CreateEvaluateResponse(message_id, v8_context, retval != nullptr, retval, exception);
+
+	v8_context->Exit();
+	browser->GetMainFrame()->SendProcessMessage(PID_BROWSER, response_msg);
+}
+
+void ClientAppRenderer::deliverPageMessage(CefRefPtr<CefFrame> frame, CefRefPtr<CefProcessMessage> message) {
+	auto v8_context = frame->GetV8Context();
+	if (v8_context && v8_context->Enter()) {
+		auto host = v8_context->GetGlobal()->GetValue("flutterHost");
+		auto listener = host && host->IsObject() ? host->GetValue("onmessage") : nullptr;
+		if (listener && listener->IsFunction()) {
+			auto value = message->GetArgumentList()->GetValue(ipc::indexPageMessageValue);
+			listener->ExecuteFunction(host, CefV8ValueList{v8_value_converter::FromCefValue(value)});
+			listener->ClearException();
+		}
+		v8_context->Exit();
+	}
+
+	// Acknowledged even without a listener, the browser only counts them.
+	frame->SendProcessMessage(PID_BROWSER, CefProcessMessage::Create(ipc::PageMessageAck));
+}
+
+void ClientAppRenderer::addUserScript(int browser_id, CefRefPtr<CefListValue> args) {
+	user_scripts_[browser_id][args->GetInt(ipc::indexUserScriptID)] = UserScript{
+		args->GetString(ipc::indexUserScriptSource),
+		static_cast<ipc::UserScriptInjectionTime>(args->GetInt(ipc::indexUserScriptInjectionTime)),
+		args->GetBool(ipc::indexUserScriptAllFrames),
+	};
+}
+
+void ClientAppRenderer::removeUserScript(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message) {
+	auto it = user_scripts_.find(browser->GetIdentifier());
+	if (it != user_scripts_.end()) it->second.erase(message->GetArgumentList()->GetInt(ipc::indexUserScriptID));
+}
+
+void ClientAppRenderer::runUserScripts(CefRefPtr<CefBrowser> browser,
+									   CefRefPtr<CefFrame> frame,
+									   CefRefPtr<CefV8Context> context) {
+	auto it = user_scripts_.find(browser->GetIdentifier());
+	if (it == user_scripts_.end() || it->second.empty()) return;
+	if (!context->Enter()) return;
+
+	std::vector<std::pair<CefString, CefString>> dom_content_loaded;
+	for (const auto& [id, script] : it->second) {
+		if (!script.all_frames && !frame->IsMain()) continue;
+
+		const CefString name = "user-script-" + std::to_string(id);
+		if (script.injection_time == ipc::UserScriptInjectionTime::DOMContentLoaded) {
+			dom_content_loaded.emplace_back(name, script.source);
+			continue;
+		}
+
+		CefRefPtr<CefV8Value> retval;
+		CefRefPtr<CefV8Exception> exception;
+		context->Eval(script.source, name, 0, retval, exception);
+	}
+
+	if (!dom_content_loaded.empty()) {
+		auto document = context->GetGlobal()->GetValue("document");
+		auto add_event_listener = document && document->IsObject() ? document->GetValue("addEventListener") : nullptr;
+		if (add_event_listener && add_event_listener->IsFunction()) {
+			auto runner = CefV8Value::CreateFunction(
+				"runUserScripts", new UserScriptRunner(std::move(dom_content_loaded)));
+			add_event_listener->ExecuteFunction(document, CefV8ValueList{
+				CefV8Value::CreateString("DOMContentLoaded"),
+				runner,
+			});
+		}
+	}
+
+	context->Exit();
+}
@@ -6,9 +6,13 @@
 #define COMMON_RENDERER_CLIENT_APP_RENDERER_H_
 #pragma once
 
+#include <map>
 #include <set>
+#include <string>
+#include <vector>
 
 #include "client_app.h"
+#include "ipc.h"
 #include "include/wrapper/cef_message_router.h"
 
 // Client app implementation for the renderer process.
@@ -24,9 +28,9 @@ private:
 
     // CefRenderProcessHandler methods.
     void OnWebKitInitialized() override;
-    // void OnBrowserCreated(CefRefPtr<CefBrowser> browser,
-    //                       CefRefPtr<CefDictionaryValue> extra_info) override;
-    // void OnBrowserDestroyed(CefRefPtr<CefBrowser> browser) override;
+    void OnBrowserCreated(CefRefPtr<CefBrowser> browser,
+                          CefRefPtr<CefDictionaryValue> extra_info) override;
+    void OnBrowserDestroyed(CefRefPtr<CefBrowser> browser) override;
     // CefRefPtr<CefLoadHandler> GetLoadHandler() override;
     void OnContextCreated(CefRefPtr<CefBrowser> browser,
                           CefRefPtr<CefFrame> frame,
@@ -55,6 +59,53 @@ private:
 					   CefRefPtr<CefFrame> frame,
 					   CefProcessId source_process,
 					   CefRefPtr<CefProcessMessage> message);
+    void evaluateJavaScriptBatch(CefRefPtr<CefBrowser> browser,
+                                 CefRefPtr<CefFrame> frame,
+                                 CefRefPtr<CefProcessMessage> message);
+
+    // Sources registered with registerScript by browser id and handle.
+    std::map<int, std::map<int, CefString>> script_sources_;
+
+    // Functions compiled from script_sources_ in one V8 context, dropped with
+    // the context.
+    struct CompiledScripts {
+        int browser_id;
+        CefRefPtr<CefV8Context> context;
+        std::map<int, CefRefPtr<CefV8Value>> functions;
+    };
+    std::vector<CompiledScripts> compiled_scripts_;
+
+    void deliverPageMessage(CefRefPtr<CefFrame> frame, CefRefPtr<CefProcessMessage> message);
+    struct UserScript {
+        CefString source;
+        ipc::UserScriptInjectionTime injection_time;
+        bool all_frames;
+    };
+    // Scripts added with addUserScript by browser id and script id, which
+    // gives their order.
+    std::map<int, std::map<int, UserScript>> user_scripts_;
+
+    // |args| is the argument list of an AddUserScript message.
+    void addUserScript(int browser_id, CefRefPtr<CefListValue> args);
+    void removeUserScript(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+    // Runs the document start scripts and schedules the DOMContentLoaded ones.
+    void runUserScripts(CefRefPtr<CefBrowser> browser,
+                        CefRefPtr<CefFrame> frame,
+                        CefRefPtr<CefV8Context> context);
+
+    // |args| is the argument list of a RegisterScriptRequest message.
+    void registerScript(int browser_id, CefRefPtr<CefListValue> args);
+    void unregisterScript(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> message);
+    void invokeScript(CefRefPtr<CefBrowser> browser,
+                      CefRefPtr<CefFrame> frame,
+                      CefRefPtr<CefProcessMessage> message);
+    // Returns the function of |handle| in |context|, compiling it on first use.
+    // On failure either |exception| or |error| is set. |context| must be entered.
+    CefRefPtr<CefV8Value> getCompiledScript(int browser_id,
+                                            CefRefPtr<CefV8Context> context,
+                                            int handle,
+                                            CefRefPtr<CefV8Exception>& exception,
+                                            std::string* error);
 
     IMPLEMENT_REFCOUNTING(ClientAppRenderer);
     DISALLOW_COPY_AND_ASSIGN(ClientAppRenderer);
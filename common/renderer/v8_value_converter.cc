@@ -0,0 +1,216 @@
+#include "v8_value_converter.h"
+
+#include <cmath>
+
+namespace
+{
+
+class Converter {
+public:
+    explicit Converter(CefRefPtr<CefV8Context> context) {
+        auto array_buffer = context->GetGlobal()->GetValue("ArrayBuffer");
+        if (array_buffer && array_buffer->IsObject()) {
+            is_view_ = array_buffer->GetValue("isView");
+        }
+    }
+
+    CefRefPtr<CefValue> Convert(CefRefPtr<CefV8Value> value, int depth) {
+        auto result = CefValue::Create();
+        if (!value || !value->IsValid() || value->IsUndefined() || value->IsNull()) {
+            result->SetNull();
+        } else if (value->IsBool()) {
+            result->SetBool(value->GetBoolValue());
+        } else if (value->IsInt()) {
+            result->SetInt(value->GetIntValue());
+        } else if (value->IsUInt() || value->IsDouble()) {
+            const auto d = value->GetDoubleValue();
+            // JSON has no representation for NaN and infinities either.
+            if (std::isfinite(d)) {
+                result->SetDouble(d);
+            } else {
+                result->SetNull();
+            }
+        } else if (value->IsString()) {
+            const auto s = value->GetStringValue();
+            if (!Consume(s.length())) return nullptr;
+            result->SetString(s);
+        } else if (value->IsDate()) {
+            // toISOString throws on invalid dates, which JSON turns into null.
+            auto iso = value->GetValue("toISOString");
+            auto s = iso && iso->IsFunction() ? iso->ExecuteFunction(value, CefV8ValueList()) : nullptr;
+            if (s && s->IsString()) {
+                result->SetString(s->GetStringValue());
+            } else {
+                result->SetNull();
+            }
+        } else if (value->IsArrayBuffer()) {
+            return ConvertBinary(BinaryViewOf(value));
+        } else if (depth >= v8_value_converter::kMaxDepth) {
+            error_ = "Value is nested too deeply";
+            return nullptr;
+        } else if (value->IsArray()) {
+            auto list = CefListValue::Create();
+            const int length = value->GetArrayLength();
+            list->SetSize(length);
+            for (int i = 0; i < length; i++) {
+                auto item = value->GetValue(i);
+                if (item && item->IsFunction()) {
+                    list->SetNull(i);
+                    continue;
+                }
+                auto converted = Convert(item, depth + 1);
+                if (!converted) return nullptr;
+                list->SetValue(i, converted);
+            }
+            result->SetList(list);
+        } else if (value->IsFunction()) {
+            result->SetNull();
+        } else if (value->IsObject()) {
+            if (IsArrayBufferView(value)) {
+                return ConvertBinary(BinaryViewOf(value));
+            }
+
+            auto dict = CefDictionaryValue::Create();
+            std::vector<CefString> keys;
+            value->GetKeys(keys);
+            for (const auto& key : keys) {
+                auto item = value->GetValue(key);
+                if (!item || item->IsUndefined() || item->IsFunction()) continue;
+
+                if (!Consume(key.length())) return nullptr;
+                auto converted = Convert(item, depth + 1);
+                if (!converted) return nullptr;
+                dict->SetValue(key, converted);
+            }
+            result->SetDictionary(dict);
+        } else {
+            result->SetNull();
+        }
+
+        if (!Consume(sizeof(double))) return nullptr;
+        return result;
+    }
+
+    const std::string& error() const { return error_; }
+
+    std::optional<v8_value_converter::BinaryView> BinaryViewOf(CefRefPtr<CefV8Value> value) {
+        auto buffer = value;
+        size_t offset = 0;
+        size_t length = 0;
+        if (value->IsArrayBuffer()) {
+            length = value->GetArrayBufferByteLength();
+        } else if (value->IsObject() && IsArrayBufferView(value)) {
+            buffer = value->GetValue("buffer");
+            offset = static_cast<size_t>(value->GetValue("byteOffset")->GetUIntValue());
+            length = static_cast<size_t>(value->GetValue("byteLength")->GetUIntValue());
+        } else {
+            return std::nullopt;
+        }
+
+        if (!buffer || !buffer->IsArrayBuffer() || offset + length > buffer->GetArrayBufferByteLength()) {
+            return std::nullopt;
+        }
+        const auto data = static_cast<const uint8_t*>(buffer->GetArrayBufferData());
+        return v8_value_converter::BinaryView{data ? data + offset : nullptr, data ? length : 0};
+    }
+
+private:
+    CefRefPtr<CefV8Value> is_view_;
+    size_t size_ = 0;
+    std::string error_;
+
+    bool Consume(size_t bytes) {
+        size_ += bytes;
+        if (size_ > v8_value_converter::kMaxSize) {
+            error_ = "Value is too large";
+            return false;
+        }
+        return true;
+    }
+
+    bool IsArrayBufferView(CefRefPtr<CefV8Value> value) {
+        if (!is_view_ || !is_view_->IsFunction()) return false;
+        auto r = is_view_->ExecuteFunction(nullptr, CefV8ValueList{value});
+        return r && r->IsBool() && r->GetBoolValue();
+    }
+
+    CefRefPtr<CefValue> ConvertBinary(const std::optional<v8_value_converter::BinaryView>& view) {
+        auto result = CefValue::Create();
+        if (!view) {
+            result->SetNull();
+            return result;
+        }
+        if (!Consume(view->size)) return nullptr;
+
+        // CefBinaryValue cannot be empty, empty buffers become empty lists.
+        if (view->size == 0) {
+            result->SetList(CefListValue::Create());
+        } else {
+            result->SetBinary(CefBinaryValue::Create(view->data, view->size));
+        }
+        return result;
+    }
+};
+
+}
+
+namespace v8_value_converter
+{
+
+CefRefPtr<CefValue> ToCefValue(CefRefPtr<CefV8Context> context,
+                               CefRefPtr<CefV8Value> value,
+                               std::string* error) {
+    Converter converter(context);
+    auto result = converter.Convert(value, 0);
+    if (!result && error) *error = converter.error();
+    return result;
+}
+
+CefRefPtr<CefV8Value> FromCefValue(CefRefPtr<CefValue> value) {
+    if (!value) return CefV8Value::CreateNull();
+
+    switch (value->GetType()) {
+    case VTYPE_BOOL:
+        return CefV8Value::CreateBool(value->GetBool());
+    case VTYPE_INT:
+        return CefV8Value::CreateInt(value->GetInt());
+    case VTYPE_DOUBLE:
+        return CefV8Value::CreateDouble(value->GetDouble());
+    case VTYPE_STRING:
+        return CefV8Value::CreateString(value->GetString());
+    case VTYPE_BINARY: {
+        auto binary = value->GetBinary();
+        return CefV8Value::CreateArrayBufferWithCopy(const_cast<void*>(binary->GetRawData()), binary->GetSize());
+    }
+    case VTYPE_LIST: {
+        auto list = value->GetList();
+        const auto size = static_cast<int>(list->GetSize());
+        auto array = CefV8Value::CreateArray(size);
+        for (int i = 0; i < size; i++) {
+            array->SetValue(i, FromCefValue(list->GetValue(i)));
+        }
+        return array;
+    }
+    case VTYPE_DICTIONARY: {
+        auto dict = value->GetDictionary();
+        CefDictionaryValue::KeyList keys;
+        dict->GetKeys(keys);
+        auto object = CefV8Value::CreateObject(nullptr, nullptr);
+        for (const auto& key : keys) {
+            object->SetValue(key, FromCefValue(dict->GetValue(key)), V8_PROPERTY_ATTRIBUTE_NONE);
+        }
+        return object;
+    }
+    default:
+        return CefV8Value::CreateNull();
+    }
+}
+
+std::optional<BinaryView> GetBinaryView(CefRefPtr<CefV8Context> context, CefRefPtr<CefV8Value> value) {
+    if (!value || !value->IsValid()) return std::nullopt;
+    if (!value->IsArrayBuffer() && (!value->IsObject() || value->IsArray())) return std::nullopt;
+
+    return Converter(context).BinaryViewOf(value);
+}
+
+} // namespace v8_value_converter
@@ -0,0 +1,42 @@
+#ifndef COMMON_RENDERER_V8_VALUE_CONVERTER_H_
+#define COMMON_RENDERER_V8_VALUE_CONVERTER_H_
+#pragma once
+
+#include "include/cef_v8.h"
+#include "include/cef_values.h"
+
+#include <optional>
+#include <string>
+
+namespace v8_value_converter
+{
+
+// Values nested deeper or larger than this fail the conversion instead of
+// stalling the renderer or the IPC channel, cyclic objects hit the depth limit.
+constexpr int kMaxDepth = 64;
+constexpr size_t kMaxSize = 256 * 1024 * 1024;
+
+// Converts |value| to a CefValue following the JSON.stringify rules, except
+// that ArrayBuffers and typed arrays become binary values (empty lists when
+// empty) and dates ISO strings. Must be called with |context| entered. Returns nullptr and sets
+// |error| if the value exceeds the limits.
+CefRefPtr<CefValue> ToCefValue(CefRefPtr<CefV8Context> context,
+                               CefRefPtr<CefV8Value> value,
+                               std::string* error);
+
+// Converts |value| to a V8 value, binary values become ArrayBuffers holding a
+// copy of the bytes. Must be called with a context entered.
+CefRefPtr<CefV8Value> FromCefValue(CefRefPtr<CefValue> value);
+
+struct BinaryView {
+    const uint8_t* data;
+    size_t size;
+};
+
+// Returns the bytes of an ArrayBuffer or typed array without copying them,
+// std::nullopt for other values. Only valid while |context| stays entered.
+std::optional<BinaryView> GetBinaryView(CefRefPtr<CefV8Context> context, CefRefPtr<CefV8Value> value);
+
+} // namespace v8_value_converter
+
+#endif  // COMMON_RENDERER_V8_VALUE_CONVERTER_H_
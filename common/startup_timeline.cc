@@ -0,0 +1,57 @@
+#include "startup_timeline.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace
+{
+    using startup_timeline::Milestone;
+
+    struct MilestoneName {
+        Milestone milestone;
+        const char* name;
+    };
+
+    const MilestoneName kMilestoneNames[] = {
+        {Milestone::LibraryLoaded, "libraryLoaded"},
+        {Milestone::StartRequested, "startRequested"},
+        {Milestone::CefLibraryLoadStarted, "cefLibraryLoadStarted"},
+        {Milestone::CefLibraryLoaded, "cefLibraryLoaded"},
+        {Milestone::CefInitializeStarted, "cefInitializeStarted"},
+        {Milestone::CefInitializeFinished, "cefInitializeFinished"},
+        {Milestone::ContextInitialized, "contextInitialized"},
+        {Milestone::FirstBrowserCreated, "firstBrowserCreated"},
+        {Milestone::FirstPaint, "firstPaint"},
+    };
+
+    constexpr size_t kMilestoneCount = sizeof(kMilestoneNames) / sizeof(kMilestoneNames[0]);
+
+    // Set while the library is loaded, before any other milestone.
+    const auto kOrigin = std::chrono::steady_clock::now();
+
+    // Microseconds since kOrigin, -1 until the milestone is reached.
+    std::atomic<int64_t> timestamps[kMilestoneCount] = {0, -1, -1, -1, -1, -1, -1, -1, -1};
+}
+
+namespace startup_timeline
+{
+
+void Record(Milestone milestone) {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - kOrigin).count();
+    int64_t unset = -1;
+    timestamps[static_cast<size_t>(milestone)].compare_exchange_strong(unset, elapsed);
+}
+
+flutter::EncodableMap ToEncodableMap() {
+    flutter::EncodableMap map;
+    for (const auto& m : kMilestoneNames) {
+        const auto timestamp = timestamps[static_cast<size_t>(m.milestone)].load();
+        if (timestamp < 0) continue;
+        map[flutter::EncodableValue(m.name)] = flutter::EncodableValue(timestamp);
+    }
+    return map;
+}
+
+} // namespace startup_timeline
@@ -0,0 +1,34 @@
+#ifndef COMMON_STARTUP_TIMELINE_H_
+#define COMMON_STARTUP_TIMELINE_H_
+#pragma once
+
+#include <flutter/encodable_value.h>
+
+namespace startup_timeline
+{
+
+// Milestones of the CEF startup of the process, each is recorded the first
+// time it happens only.
+enum class Milestone {
+    // The plugin library was loaded, the origin of the timeline.
+    LibraryLoaded = 0,
+    StartRequested,
+    // libcef.dll is delay-loaded, between these two on the CEF thread.
+    CefLibraryLoadStarted,
+    CefLibraryLoaded,
+    CefInitializeStarted,
+    CefInitializeFinished,
+    ContextInitialized,
+    FirstBrowserCreated,
+    FirstPaint,
+};
+
+void Record(Milestone milestone);
+
+// Microseconds since LibraryLoaded by milestone name, the milestones not
+// reached yet are left out.
+flutter::EncodableMap ToEncodableMap();
+
+} // namespace startup_timeline
+
+#endif  // COMMON_STARTUP_TIMELINE_H_
@@ -1,6 +1,7 @@
 #include "texture_handler.h"
 
-TextureHandler::TextureHandler() {
+TextureHandler::TextureHandler(flutter::TextureRegistrar* texture_registrar)
+    : texture_registrar_(texture_registrar) {
     m_texture_ = std::make_unique<flutter::TextureVariant>(
         flutter::PixelBufferTexture([this](size_t width, size_t height) -> const FlutterDesktopPixelBuffer* {
             auto buffer = pixel_buffer.get();
@@ -13,7 +14,7 @@ TextureHandler::TextureHandler() {
             return buffer;
         })
     );
-    texture_id_ = TextureHandler::texture_registrar_->RegisterTexture(m_texture_.get());
+    texture_id_ = texture_registrar_->RegisterTexture(m_texture_.get());
 }
 
 TextureHandler::~TextureHandler() {
@@ -63,8 +64,3 @@ void TextureHandler::SwapBufferFromBgraToRgba(void* _dest, const void* _src, int
         dest[i] = rgba;
     }
 }
-
-flutter::TextureRegistrar* TextureHandler::texture_registrar_;
-void TextureHandler::InitTextureRegistrar(flutter::TextureRegistrar* registrar) {
-    TextureHandler::texture_registrar_ = registrar;
-}
@@ -14,18 +14,19 @@ private:
 	std::unique_ptr<uint8_t> backing_pixel_buffer;
 	std::mutex buffer_mutex_;
 	std::unique_ptr<flutter::TextureVariant> m_texture_;
+	// The registrar of the engine that created the browser, textures are
+	// never shared between engines.
+	flutter::TextureRegistrar* texture_registrar_;
 
-    static flutter::TextureRegistrar* texture_registrar_;
     static void SwapBufferFromBgraToRgba(void* _dest, const void* _src, int width, int height);
 
 public:
-    TextureHandler();
+    explicit TextureHandler(flutter::TextureRegistrar* texture_registrar);
     ~TextureHandler();
 
     int64_t texture_id() const { return texture_id_; }
 
     void onPaintCallback(const void* buffer, int32_t width, int32_t height);
-    static void InitTextureRegistrar(flutter::TextureRegistrar* registrar);
 };
 
 #endif  // WEBVIEW_CEF_WINDOWS_TEXTURE_HANDLER
@@ -1,3 +1,4 @@
+#include <climits>
 #include <iostream>
 #include <optional>
 #include "util.h"
@@ -32,4 +33,89 @@ std::optional<bool> GetBoolFromMap(const flutter::EncodableMap* m, const std::st
     return std::nullopt;
 }
 
+flutter::EncodableValue CefValueToEncodableValue(CefRefPtr<CefValue> value) {
+    if (!value) return flutter::EncodableValue();
+
+    switch (value->GetType()) {
+    case VTYPE_BOOL:
+        return flutter::EncodableValue(value->GetBool());
+    case VTYPE_INT:
+        return flutter::EncodableValue(static_cast<int32_t>(value->GetInt()));
+    case VTYPE_DOUBLE:
+        return flutter::EncodableValue(value->GetDouble());
+    case VTYPE_STRING:
+        return flutter::EncodableValue(value->GetString().ToString());
+    case VTYPE_BINARY: {
+        auto binary = value->GetBinary();
+        std::vector<uint8_t> data(binary->GetSize());
+        if (!data.empty()) binary->GetData(data.data(), data.size(), 0);
+        return flutter::EncodableValue(std::move(data));
+    }
+    case VTYPE_LIST: {
+        auto list = value->GetList();
+        flutter::EncodableList result;
+        result.reserve(list->GetSize());
+        for (size_t i = 0; i < list->GetSize(); i++) {
+            result.push_back(CefValueToEncodableValue(list->GetValue(i)));
+        }
+        return flutter::EncodableValue(std::move(result));
+    }
+    case VTYPE_DICTIONARY: {
+        auto dict = value->GetDictionary();
+        CefDictionaryValue::KeyList keys;
+        dict->GetKeys(keys);
+        flutter::EncodableMap result;
+        for (const auto& key : keys) {
+            result.emplace(flutter::EncodableValue(key.ToString()), CefValueToEncodableValue(dict->GetValue(key)));
+        }
+        return flutter::EncodableValue(std::move(result));
+    }
+    default:
+        return flutter::EncodableValue();
+    }
+}
+
+CefRefPtr<CefValue> EncodableValueToCefValue(const flutter::EncodableValue& value) {
+    auto result = CefValue::Create();
+    if (const auto b = std::get_if<bool>(&value)) {
+        result->SetBool(*b);
+    } else if (const auto i = std::get_if<int32_t>(&value)) {
+        result->SetInt(*i);
+    } else if (const auto l = std::get_if<int64_t>(&value)) {
+        if (*l >= INT32_MIN && *l <= INT32_MAX) {
+            result->SetInt(static_cast<int>(*l));
+        } else {
+            result->SetDouble(static_cast<double>(*l));
+        }
+    } else if (const auto d = std::get_if<double>(&value)) {
+        result->SetDouble(*d);
+    } else if (const auto s = std::get_if<std::string>(&value)) {
+        result->SetString(*s);
+    } else if (const auto bytes = std::get_if<std::vector<uint8_t>>(&value)) {
+        if (bytes->empty()) {
+            result->SetList(CefListValue::Create());
+        } else {
+            result->SetBinary(CefBinaryValue::Create(bytes->data(), bytes->size()));
+        }
+    } else if (const auto list = std::get_if<flutter::EncodableList>(&value)) {
+        auto cef_list = CefListValue::Create();
+        cef_list->SetSize(list->size());
+        for (size_t n = 0; n < list->size(); n++) {
+            cef_list->SetValue(n, EncodableValueToCefValue((*list)[n]));
+        }
+        result->SetList(cef_list);
+    } else if (const auto map = std::get_if<flutter::EncodableMap>(&value)) {
+        auto dict = CefDictionaryValue::Create();
+        for (const auto& [k, v] : *map) {
+            if (const auto key = std::get_if<std::string>(&k)) {
+                dict->SetValue(*key, EncodableValueToCefValue(v));
+            }
+        }
+        result->SetDictionary(dict);
+    } else {
+        result->SetNull();
+    }
+    return result;
+}
+
 }
@@ -4,11 +4,20 @@
 
 #include <flutter/standard_method_codec.h>
 
+#include "include/cef_values.h"
+
 namespace util {
 
 std::optional<std::string> GetStringFromMap(const flutter::EncodableMap* m, const std::string key);
 std::optional<std::int32_t> GetIntFromMap(const flutter::EncodableMap* m, const std::string key);
 std::optional<bool> GetBoolFromMap(const flutter::EncodableMap* m, const std::string key);
 
+// Binary values become std::vector<uint8_t>, which Dart receives as Uint8List.
+flutter::EncodableValue CefValueToEncodableValue(CefRefPtr<CefValue> value);
+// The reverse, std::vector<uint8_t> becomes a binary value (an empty list when
+// empty), int64 values that do not fit an int a double, and maps keep their
+// string keys only.
+CefRefPtr<CefValue> EncodableValueToCefValue(const flutter::EncodableValue& value);
+
 }
 #endif // COMMON_UTIL_H_
@@ -0,0 +1,119 @@
+// Measures the page to Dart RPC bridge: round trip latency of sequential
+// flutterHost.invoke calls, throughput of concurrent calls, and the rate of
+// responses streamed to one persistent query.
+//
+// flutter run -d windows --release -t lib/benchmarks/cef_query_rpc.dart
+
+import 'package:flutter/material.dart';
+import 'package:webview_cef/webview_cef.dart';
+
+const _sequentialCalls = 2000;
+const _concurrentCalls = 20000;
+const _streamedResponses = 20000;
+
+// Runs in the page and reports every measurement back through the bridge.
+const _benchmarkScript = '''
+(async () => {
+  const report = (line) => flutterHost.invoke('report:' + line);
+
+  const latencies = [];
+  for (let i = 0; i < $_sequentialCalls; i++) {
+    const start = performance.now();
+    await flutterHost.invoke('echo:' + i);
+    latencies.push(performance.now() - start);
+  }
+  latencies.sort((a, b) => a - b);
+  const at = (q) => latencies[Math.floor(q * (latencies.length - 1))].toFixed(3);
+  await report('sequential   p50 ' + at(0.5) + ' ms  p99 ' + at(0.99) + ' ms');
+
+  let start = performance.now();
+  const calls = [];
+  for (let i = 0; i < $_concurrentCalls; i++) calls.push(flutterHost.invoke('echo:' + i));
+  await Promise.all(calls);
+  let seconds = (performance.now() - start) / 1000;
+  await report('concurrent   ' + Math.round($_concurrentCalls / seconds) + ' calls/s');
+
+  start = performance.now();
+  await new Promise((resolve, reject) => {
+    let received = 0;
+    const cancel = flutterHost.subscribe('stream:$_streamedResponses', () => {
+      if (++received === $_streamedResponses) {
+        cancel();
+        resolve();
+      }
+    }, reject);
+  });
+  seconds = (performance.now() - start) / 1000;
+  await report('streamed     ' + Math.round($_streamedResponses / seconds) + ' responses/s');
+
+  await report('done');
+})();
+''';
+
+void main() {
+  WidgetsFlutterBinding.ensureInitialized();
+  runApp(const MaterialApp(home: _BenchmarkPage()));
+}
+
+class _BenchmarkPage extends StatefulWidget {
+  const _BenchmarkPage();
+
+  @override
+  State<_BenchmarkPage> createState() => _BenchmarkPageState();
+}
+
+class _BenchmarkPageState extends State<_BenchmarkPage> {
+  final _controller = WebViewController(headless: true);
+  final _lines = <String>[];
+
+  @override
+  void initState() {
+    super.initState();
+    _controller.cefQueryHandler = _handleQuery;
+    _run();
+  }
+
+  Future<void> _run() async {
+    await _controller.initialize();
+    await _controller.ready;
+    await _controller.evaluateJavaScript(_benchmarkScript);
+  }
+
+  Future<String?> _handleQuery(CefQuery query) async {
+    final request = query.request;
+    if (request.startsWith('echo:')) return request;
+    if (request.startsWith('report:')) {
+      _log(request.substring('report:'.length));
+      return null;
+    }
+    if (request.startsWith('stream:')) {
+      final count = int.parse(request.substring('stream:'.length));
+      for (var i = 0; i < count && !query.isCanceled; i++) {
+        query.respond('$i');
+      }
+      return null;
+    }
+    throw CefQueryError(404, 'unknown request $request');
+  }
+
+  void _log(String line) {
+    debugPrint(line);
+    setState(() => _lines.add(line));
+  }
+
+  @override
+  void dispose() {
+    _controller.dispose();
+    super.dispose();
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    return Scaffold(
+      body: ListView(
+        padding: const EdgeInsets.all(16),
+        children: [for (final l in _lines) Text(l, style: const TextStyle(fontFamily: 'monospace'))],
+      ),
+    );
+  }
+}
@@ -0,0 +1,91 @@
+// Compares the page to Dart message rate of flutterHost.postMessage with the
+// cefQuery based flutterHost.invoke, for small telemetry records.
+//
+// flutter run -d windows --release -t lib/benchmarks/host_message_rate.dart
+
+import 'dart:async';
+
+import 'package:flutter/material.dart';
+import 'package:webview_cef/webview_cef.dart';
+
+const _messages = 50000;
+
+const _record = "{name: 'frame', t: performance.now(), fps: 60, heap: 12345678, tags: ['a', 'b']}";
+
+void main() {
+  WidgetsFlutterBinding.ensureInitialized();
+  runApp(const MaterialApp(home: _BenchmarkPage()));
+}
+
+class _BenchmarkPage extends StatefulWidget {
+  const _BenchmarkPage();
+
+  @override
+  State<_BenchmarkPage> createState() => _BenchmarkPageState();
+}
+
+class _BenchmarkPageState extends State<_BenchmarkPage> {
+  final _controller = WebViewController(headless: true);
+  final _lines = <String>['path            messages/s'];
+
+  int _received = 0;
+  Completer<void>? _allReceived;
+
+  @override
+  void initState() {
+    super.initState();
+    _controller.onHostMessage = (_) => _count();
+    _controller.cefQueryHandler = (_) {
+      _count();
+      return null;
+    };
+    _run();
+  }
+
+  Future<void> _run() async {
+    await _controller.initialize();
+    await _controller.ready;
+
+    await _measure('postMessage', 'flutterHost.postMessage($_record)');
+    await _measure('cefQuery', 'flutterHost.invoke(JSON.stringify($_record))');
+    _log('done');
+  }
+
+  Future<void> _measure(String name, String send) async {
+    _received = 0;
+    _allReceived = Completer();
+
+    final stopwatch = Stopwatch()..start();
+    await _controller.evaluateJavaScript('for (let i = 0; i < $_messages; i++) $send;');
+    await _allReceived!.future;
+    stopwatch.stop();
+
+    final rate = _messages / (stopwatch.elapsedMicroseconds / 1e6);
+    _log('${name.padRight(15)} ${rate.toStringAsFixed(0).padLeft(10)}');
+  }
+
+  void _count() {
+    if (++_received == _messages) _allReceived?.complete();
+  }
+
+  void _log(String line) {
+    debugPrint(line);
+    setState(() => _lines.add(line));
+  }
+
+  @override
+  void dispose() {
+    _controller.dispose();
+    super.dispose();
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    return Scaffold(
+      body: ListView(
+        padding: const EdgeInsets.all(16),
+        children: [for (final l in _lines) Text(l, style: const TextStyle(fontFamily: 'monospace'))],
+      ),
+    );
+  }
+}
@@ -0,0 +1,97 @@
+// Measures evaluateJavaScript throughput for string and ArrayBuffer results
+// from 1 KB to 64 MB, results of 64 KB and more use the shared memory path.
+//
+// flutter run -d windows --release -t lib/benchmarks/js_result_throughput.dart
+
+import 'package:flutter/material.dart';
+import 'package:webview_cef/webview_cef.dart';
+
+const _sizes = [
+  1 << 10,
+  16 << 10,
+  64 << 10,
+  256 << 10,
+  1 << 20,
+  4 << 20,
+  16 << 20,
+  64 << 20,
+];
+
+void main() {
+  WidgetsFlutterBinding.ensureInitialized();
+  runApp(const MaterialApp(home: _BenchmarkPage()));
+}
+
+class _BenchmarkPage extends StatefulWidget {
+  const _BenchmarkPage();
+
+  @override
+  State<_BenchmarkPage> createState() => _BenchmarkPageState();
+}
+
+class _BenchmarkPageState extends State<_BenchmarkPage> {
+  final _controller = WebViewController(headless: true);
+  final _lines = <String>['payload      type     ms/call       MB/s'];
+
+  @override
+  void initState() {
+    super.initState();
+    _run();
+  }
+
+  Future<void> _run() async {
+    await _controller.initialize();
+    await _controller.ready;
+
+    for (final size in _sizes) {
+      await _measure(size, 'string', "'x'.repeat($size)");
+      await _measure(size, 'binary', 'new Uint8Array($size).fill(7).buffer');
+    }
+    _log('done');
+  }
+
+  Future<void> _measure(int size, String type, String code) async {
+    // Fewer iterations for the large payloads keep the run short.
+    final iterations = size >= (16 << 20) ? 3 : (size >= (1 << 20) ? 10 : 100);
+
+    final first = await _controller.evaluateJavaScript(code);
+    if ((first as dynamic).length != size) {
+      _log('${_label(size)} $type: unexpected result length ${first.length}');
+      return;
+    }
+
+    final stopwatch = Stopwatch()..start();
+    for (var i = 0; i < iterations; i++) {
+      await _controller.evaluateJavaScript(code);
+    }
+    stopwatch.stop();
+
+    final ms = stopwatch.elapsedMicroseconds / 1000 / iterations;
+    final mbPerSecond = size / (1 << 20) / (ms / 1000);
+    _log('${_label(size).padRight(12)} ${type.padRight(8)} '
+        '${ms.toStringAsFixed(2).padLeft(8)} ${mbPerSecond.toStringAsFixed(1).padLeft(10)}');
+  }
+
+  String _label(int size) => size >= (1 << 20) ? '${size >> 20} MB' : '${size >> 10} KB';
+
+  void _log(String line) {
+    debugPrint(line);
+    setState(() => _lines.add(line));
+  }
+
+  @override
+  void dispose() {
+    _controller.dispose();
+    super.dispose();
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    return Scaffold(
+      body: ListView(
+        padding: const EdgeInsets.all(16),
+        children: [for (final l in _lines) Text(l, style: const TextStyle(fontFamily: 'monospace'))],
+      ),
+    );
+  }
+}
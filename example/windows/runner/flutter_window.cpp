@@ -3,6 +3,7 @@
 #include <optional>
 
 #include "flutter/generated_plugin_registrant.h"
+#include "webview_cef/webview_cef_plugin_c_api.h"
 
 FlutterWindow::FlutterWindow(const flutter::DartProject& project)
     : project_(project) {}
@@ -31,6 +32,9 @@ bool FlutterWindow::OnCreate() {
 
 void FlutterWindow::OnDestroy() {
   if (flutter_controller_) {
+    // Close the browsers and stop CEF while the engine they paint into still
+    // exists, giving up after one second.
+    ShutdownCEF(1000);
     flutter_controller_ = nullptr;
   }
 
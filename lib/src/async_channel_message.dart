@@ -14,15 +14,22 @@ class _AsyncChannelMessageManager {
   static const _keyID = '_id_';
   static const _keyResult = '_result_';
   static const _keyError = '_error_';
+  static const _keyIDs = '_ids_';
+  static const _errorTimedOut = 'Evaluation timed out';
 
   static bool isEvalError(String s) => s == "Evaluate Error";
 
   static handleChannelEvents(dynamic result) {
     final m = result as Map<dynamic, dynamic>;
+    if (m.containsKey(_keyIDs)) {
+      _failMessages((m[_keyIDs] as List<dynamic>).cast<int>(), m[_keyError] as String);
+      return;
+    }
+
     assert(m[_keyID] is int);
     final id = m[_keyID] as int;
-    assert(_channelMessages.containsKey(id));
-    final message = _channelMessages[id]!;
+    final message = _channelMessages.remove(id);
+    if (message == null) return;
     if (m.containsKey(_keyError)) {
       final errorMsg = m[_keyError] as String;
       if (isEvalError(errorMsg)) {
@@ -36,11 +43,27 @@ class _AsyncChannelMessageManager {
         message._completer.completeError(errorMsg);
       }
     } else {
-      final data = m[_keyResult] as String;
-      if (data.isEmpty) {
-        message._completer.complete();
+      // Already typed by the native side, binary data arrives as Uint8List.
+      message._completer.complete(message._convertResult(m[_keyResult]));
+    }
+  }
+
+  /// Completes a message whose result arrived outside the event channel.
+  static completeWithResult(int id, dynamic result) {
+    final message = _channelMessages.remove(id);
+    message?._completer.complete(message._convertResult(result));
+  }
+
+  /// Fails the messages that timed out, were canceled or lost their renderer.
+  static _failMessages(List<int> ids, String error) {
+    for (final id in ids) {
+      final message = _channelMessages.remove(id);
+      if (message == null) continue;
+
+      if (error == _errorTimedOut) {
+        message._completer.completeError(TimeoutException(error, message.timeout));
       } else {
-        message._completer.complete(jsonDecode(data));
+        message._completer.completeError(error);
       }
     }
   }
@@ -53,11 +76,20 @@ class _AsyncChannelMessageManager {
     return buff.toString();
   }
 
-  static Future<T> invokeMethod<T>(MethodChannel methodChannel, AsyncChannelMessage<T> message) async {
+  static Future<T> invokeMethod<T>(
+    Future<dynamic> Function(String method, dynamic arguments) invoke,
+    AsyncChannelMessage<T> message,
+  ) async {
     _AsyncChannelMessageManager.registerMessageCallback(message);
     final Map<String, dynamic> args = {};
     message.setArguments(args);
-    await methodChannel.invokeMethod(message.method, args);
+    try {
+      await invoke(message.method, args);
+    } catch (_) {
+      // Never sent, nothing will complete it.
+      _channelMessages.remove(message.id);
+      rethrow;
+    }
     return message._completer.future;
   }
 }
@@ -66,16 +98,23 @@ abstract class AsyncChannelMessage<T> {
   final int id;
   final String method;
   final bool throwEvalError;
+
+  /// The native side fails the message if no result arrived in time.
+  final Duration? timeout;
   final Completer<T> _completer = Completer();
 
   AsyncChannelMessage(this.method, {
     this.throwEvalError = false,
+    this.timeout,
   }) : id = _AsyncChannelMessageManager.nextID;
 
   @mustCallSuper
   setArguments(Map<String, dynamic> m) {
     m[_AsyncChannelMessageManager._keyID] = id;
+    if (timeout != null) m['timeout'] = timeout!.inMilliseconds;
   }
+
+  T _convertResult(dynamic result) => result as T;
 }
 
 class EvaluateJavaScriptMessage extends AsyncChannelMessage {
@@ -83,7 +122,8 @@ class EvaluateJavaScriptMessage extends AsyncChannelMessage {
 
   EvaluateJavaScriptMessage(this.code, {
     bool throwEvalError = false,
-  }) : super('evaluateJavaScript', throwEvalError: throwEvalError);
+    Duration? timeout,
+  }) : super('evaluateJavaScript', throwEvalError: throwEvalError, timeout: timeout);
 
   @override
   setArguments(Map<String, dynamic> m) {
@@ -91,3 +131,63 @@ class EvaluateJavaScriptMessage extends AsyncChannelMessage {
     m['code'] = code;
   }
 }
+
+class InvokeScriptMessage extends AsyncChannelMessage {
+  final int handle;
+  final List<dynamic> arguments;
+
+  InvokeScriptMessage(this.handle, this.arguments, {
+    bool throwEvalError = false,
+    Duration? timeout,
+  }) : super('invokeScript', throwEvalError: throwEvalError, timeout: timeout);
+
+  @override
+  setArguments(Map<String, dynamic> m) {
+    super.setArguments(m);
+    m['handle'] = handle;
+    m['arguments'] = arguments;
+  }
+}
+
+/// Outcome of one script of [WebViewController.evaluateJavaScriptBatch].
+class JavaScriptResult {
+  /// The completion value of the script, null if it failed.
+  final dynamic value;
+
+  /// Null if the script succeeded, evaluation errors include their location.
+  final String? error;
+
+  const JavaScriptResult._(this.value, this.error);
+
+  bool get isError => error != null;
+}
+
+class EvaluateJavaScriptBatchMessage extends AsyncChannelMessage<List<JavaScriptResult>> {
+  final List<String> scripts;
+
+  EvaluateJavaScriptBatchMessage(this.scripts, {Duration? timeout})
+      : super('evaluateJavaScriptBatch', timeout: timeout);
+
+  @override
+  setArguments(Map<String, dynamic> m) {
+    super.setArguments(m);
+    m['scripts'] = scripts;
+  }
+
+  @override
+  List<JavaScriptResult> _convertResult(dynamic result) {
+    return [
+      for (final r in result as List<dynamic>) _convertScriptResult(r as Map<dynamic, dynamic>),
+    ];
+  }
+
+  static JavaScriptResult _convertScriptResult(Map<dynamic, dynamic> m) {
+    final error = m[_AsyncChannelMessageManager._keyError] as String?;
+    if (error == null) return JavaScriptResult._(m[_AsyncChannelMessageManager._keyResult], null);
+
+    if (_AsyncChannelMessageManager.isEvalError(error)) {
+      return JavaScriptResult._(null, _AsyncChannelMessageManager.formatEvalError(m));
+    }
+    return JavaScriptResult._(null, error);
+  }
+}
@@ -0,0 +1,60 @@
+part of webview;
+
+/// Answers a request the page sent with `flutterHost.invoke(request)` or
+/// `window.cefQuery`. The returned string resolves the Promise of the page,
+/// throwing a [CefQueryError] rejects it with its code and message.
+typedef CefQueryHandler = FutureOr<String?> Function(CefQuery query);
+
+class CefQueryError implements Exception {
+  final int code;
+  final String message;
+
+  const CefQueryError(this.code, this.message);
+
+  @override
+  String toString() => 'CefQueryError($code, $message)';
+}
+
+/// A pending request of the page.
+class CefQuery {
+  final int id;
+  final String request;
+
+  /// Persistent queries, started with `flutterHost.subscribe`, stay open for
+  /// any number of [respond] calls until [fail] ends them or the page cancels
+  /// them.
+  final bool persistent;
+
+  final WebViewController _controller;
+  final Completer<void> _canceled = Completer();
+
+  CefQuery._(this._controller, this.id, this.request, this.persistent);
+
+  /// Completes when the page cancels the query or navigates away.
+  Future<void> get canceled => _canceled.future;
+  bool get isCanceled => _canceled.isCompleted;
+
+  /// Sends [response] to the page, returns false if the query is gone.
+  Future<bool> respond(String response) async {
+    final sent = await _controller._invokeBrowserMethod<bool>('cefQueryRespond', {
+      'queryID': id,
+      'response': response,
+    });
+    return sent ?? false;
+  }
+
+  /// Rejects the query, returns false if it is gone.
+  Future<bool> fail(int errorCode, String errorMessage) async {
+    _controller._cefQueries.remove(id);
+    final sent = await _controller._invokeBrowserMethod<bool>('cefQueryFail', {
+      'queryID': id,
+      'errorCode': errorCode,
+      'errorMessage': errorMessage,
+    });
+    return sent ?? false;
+  }
+
+  void _cancel() {
+    if (!_canceled.isCompleted) _canceled.complete();
+  }
+}
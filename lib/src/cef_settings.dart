@@ -25,4 +25,54 @@ class CefSettings {
   /// result in the sandbox blocking read/write access to the [cachePath]
   /// directory.
   String? rootCachePath;
-}
\ No newline at end of file
+
+  /// Absolute path of the executable Chromium starts its child processes
+  /// with. Null uses `webview_cef_helper.exe` next to the application if it is
+  /// there, and the application itself otherwise.
+  String? subprocessPath;
+
+  /// Maximum number of renderer processes, browsers beyond it share the
+  /// existing ones. Null leaves it to Chromium, which scales it with the
+  /// system memory.
+  int? rendererProcessLimit;
+
+  /// Puts all same-site pages of a request context in one renderer process,
+  /// instead of one process per browser. Browsers only share processes with
+  /// browsers of the same context, see [RequestContextSettings.shared].
+  bool processPerSite = false;
+
+  /// Lets cross-site iframes run in the process of their parent instead of
+  /// processes of their own. Fewer processes, but the frames are no longer
+  /// isolated from each other against Spectre-style attacks.
+  bool relaxedSiteIsolation = false;
+}
+
+/// The request context of a browser, its cache, cookies and storage, see
+/// [WebViewController.requestContext]. Browsers without one use the global
+/// context configured by [GlobalCefSettings].
+@immutable
+class RequestContextSettings {
+  /// Browsers with the same name share the context for the lifetime of the
+  /// process. The settings of the first browser of a name win.
+  final String? name;
+
+  /// Where the cache and storage are kept on disk, an absolute path equal to
+  /// or under [CefSettings.rootCachePath]. Null keeps them in memory.
+  final String? cachePath;
+
+  /// A context shared by every browser using [name], so repeated loads across
+  /// webviews hit the same disk and memory cache. The browsers of a context
+  /// form a process group, only they can share renderer processes, see
+  /// [CefSettings.processPerSite] and [WebViewController.getProcessGroupUsage].
+  const RequestContextSettings.shared(String this.name, {this.cachePath});
+
+  /// An in-memory context that never touches disk. Without a [name] the
+  /// browser gets a context of its own, which goes away with it, and is not
+  /// part of any group of [WebViewController.getProcessGroupUsage].
+  const RequestContextSettings.ephemeral({this.name}) : cachePath = null;
+
+  Map<String, dynamic> _toMap() => {
+        if (name != null) 'name': name,
+        if (cachePath != null) 'cachePath': cachePath,
+      };
+}
@@ -0,0 +1,46 @@
+part of webview;
+
+/// Snapshot of the browser navigation state, pushed by the native side
+/// whenever one of its fields changes.
+@immutable
+class NavigationState {
+  final String url;
+  final String title;
+  final bool canGoBack;
+  final bool canGoForward;
+  final bool isLoading;
+  final double zoomLevel;
+
+  const NavigationState({
+    this.url = '',
+    this.title = '',
+    this.canGoBack = false,
+    this.canGoForward = false,
+    this.isLoading = false,
+    this.zoomLevel = 0.0,
+  });
+
+  /// Decodes the `[url, title, canGoBack, canGoForward, isLoading, zoomLevel]`
+  /// list sent with [WebViewEvent.navigationStateChanged].
+  factory NavigationState._fromList(List<dynamic> l) {
+    return NavigationState(
+      url: l[0] as String,
+      title: l[1] as String,
+      canGoBack: l[2] as bool,
+      canGoForward: l[3] as bool,
+      isLoading: l[4] as bool,
+      zoomLevel: l[5] as double,
+    );
+  }
+
+  NavigationState _copyWith({double? zoomLevel}) {
+    return NavigationState(
+      url: url,
+      title: title,
+      canGoBack: canGoBack,
+      canGoForward: canGoForward,
+      isLoading: isLoading,
+      zoomLevel: zoomLevel ?? this.zoomLevel,
+    );
+  }
+}
@@ -0,0 +1,90 @@
+part of webview;
+
+/// Memory and CPU usage of the renderer process of a browser, sampled by the
+/// CEF task manager, see [WebViewController.setResourceSamplingInterval].
+/// Browsers sharing a renderer process report the whole process.
+@immutable
+class ResourceUsage {
+  /// Memory footprint in bytes, -1 if unknown.
+  final int memory;
+
+  /// CPU usage in percent, 100 per fully used processor.
+  final double cpuUsage;
+
+  const ResourceUsage({required this.memory, required this.cpuUsage});
+
+  factory ResourceUsage._fromMap(Map<dynamic, dynamic> m) {
+    return ResourceUsage(memory: m['memory'] as int, cpuUsage: m['cpuUsage'] as double);
+  }
+}
+
+/// One task of the CEF task manager, a process or a worker, as returned by
+/// [WebViewController.getResourceUsage].
+@immutable
+class TaskResourceUsage {
+  /// `browser`, `gpu`, `utility`, `renderer`, `serviceWorker`...
+  final String type;
+  final String title;
+
+  /// Memory footprint in bytes, -1 if unknown.
+  final int memory;
+
+  /// GPU memory in bytes, -1 if unknown.
+  final int gpuMemory;
+
+  /// CPU usage in percent, 100 per fully used processor.
+  final double cpuUsage;
+
+  /// Browsers of this engine running in the task.
+  final List<int> browserIDs;
+
+  const TaskResourceUsage({
+    required this.type,
+    required this.title,
+    required this.memory,
+    required this.gpuMemory,
+    required this.cpuUsage,
+    required this.browserIDs,
+  });
+
+  factory TaskResourceUsage._fromMap(Map<dynamic, dynamic> m) {
+    return TaskResourceUsage(
+      type: m['type'] as String,
+      title: m['title'] as String,
+      memory: m['memory'] as int,
+      gpuMemory: m['gpuMemory'] as int,
+      cpuUsage: m['cpuUsage'] as double,
+      browserIDs: (m['browserIDs'] as List<dynamic>).cast<int>(),
+    );
+  }
+}
+
+/// Resource usage of the renderer processes of a process group, as returned
+/// by [WebViewController.getProcessGroupUsage]. Processes shared by several
+/// browsers of the group are counted once.
+@immutable
+class ProcessGroupUsage {
+  /// Memory footprint in bytes.
+  final int memory;
+
+  /// CPU usage in percent, 100 per fully used processor.
+  final double cpuUsage;
+  final int processCount;
+  final List<int> browserIDs;
+
+  const ProcessGroupUsage({
+    required this.memory,
+    required this.cpuUsage,
+    required this.processCount,
+    required this.browserIDs,
+  });
+
+  factory ProcessGroupUsage._fromMap(Map<dynamic, dynamic> m) {
+    return ProcessGroupUsage(
+      memory: m['memory'] as int,
+      cpuUsage: m['cpuUsage'] as double,
+      processCount: m['processCount'] as int,
+      browserIDs: (m['browserIDs'] as List<dynamic>).cast<int>(),
+    );
+  }
+}
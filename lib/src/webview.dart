@@ -3,15 +3,19 @@ library webview;
 import 'dart:async';
 import 'dart:convert';
 import 'dart:io';
+import 'dart:typed_data';
 import 'dart:ui';
 
 import 'package:flutter/gestures.dart';
 import 'package:flutter/material.dart';
 import 'package:flutter/services.dart';
 
+part 'cef_query.dart';
 part 'cef_settings.dart';
 part 'webview_cursor.dart';
 part 'async_channel_message.dart';
+part 'navigation_state.dart';
+part 'resource_usage.dart';
 part 'text_input.dart';
 part 'webview_controller.dart';
 
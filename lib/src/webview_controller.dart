@@ -9,10 +9,26 @@ typedef LoadingStateChangedCallback = void Function(bool isLoading);
 typedef LoadStartCallback = void Function(String url);
 typedef LoadEndCallback = void Function(int statusCode);
 typedef LoadErrorCallback = void Function(int code, String text, String url);
+typedef HostMessageCallback = void Function(dynamic message);
+typedef ResourceUsageCallback = void Function(ResourceUsage usage);
+typedef RenderProcessGoneCallback = void Function(RenderProcessGoneDetails details);
 
 const MethodChannel _pluginChannel = MethodChannel("webview_cef");
+
+/// Shared by every browser, calls carry `[browserID, arguments]`.
+const MethodChannel _browsersChannel = MethodChannel("webview_cef/browsers");
+const EventChannel _browsersEventChannel = EventChannel("webview_cef/browsers/events");
+
+/// Raw binary channel for large results, every message is a
+/// [_kPayloadHeaderSize] bytes header followed by the payload.
+const _kBrowsersPayloadChannel = "webview_cef/browsers/payloads";
+const _kPayloadHeaderSize = 16;
+const _kPayloadTypeString = 0;
+const _kPayloadTypeBinary = 1;
+/// A buffer the page transferred with `flutterHost.postMessage`.
+const _kPayloadTypeHostMessage = 0x80;
 bool _hasCallStartCEF = false;
-final _cefStarted = Completer();
+var _cefStarted = Completer();
 
 _startCEF() async {
   if (!_hasCallStartCEF) {
@@ -20,34 +36,135 @@ _startCEF() async {
 
     _pluginChannel.setMethodCallHandler((call) async {
       if (call.method == 'onCEFInitialized') {
-        _cefStarted.complete();
+        if (!_cefStarted.isCompleted) _cefStarted.complete();
+      } else if (call.method == 'onCEFStartFailed') {
+        // libcef.dll could not be loaded or CEF failed to initialize, the
+        // next call asks again.
+        _hasCallStartCEF = false;
+        if (!_cefStarted.isCompleted) {
+          _cefStarted.completeError(StateError('CEF failed to start'));
+        }
+        _cefStarted = Completer();
       }
     });
 
     _pluginChannel.invokeMethod('startCEF', {
       'cachePath': GlobalCefSettings.cachePath,
       'rootCachePath': GlobalCefSettings.rootCachePath,
+      'subprocessPath': GlobalCefSettings.subprocessPath,
+      if (GlobalCefSettings.rendererProcessLimit != null)
+        'rendererProcessLimit': GlobalCefSettings.rendererProcessLimit,
+      'processPerSite': GlobalCefSettings.processPerSite,
+      'relaxedSiteIsolation': GlobalCefSettings.relaxedSiteIsolation,
     });
   }
 
   await _cefStarted.future;
 }
 
-const _kEventTitleChanged = "titleChanged";
-const _kEventURLChanged = "urlChanged";
-const _kEventCursorChanged = "cursorChanged";
-const _kEventScrollOffsetChanged = "scrollOffsetChanged";
-const _kEventLoadingProgressChanged = "loadingProgressChanged";
-const _kEventLoadingStateChanged = "loadingStateChanged";
-const _kEventLoadStart = "loadStart";
-const _kEventLoadEnd = "loadEnd";
-const _kEventLoadError = "loadError";
-const _kIMEComposionPositionChanged = "imeComposionPositionChanged";
 const _kEventAsyncChannelMessage = 'asyncChannelMessage';
 
+/// Id of [_kEventAsyncChannelMessage] in the compact event encoding, the ids of
+/// the other events are the indices of [WebViewEvent].
+const _kEventAsyncChannelMessageID = 128;
+
+/// Size of the header of fixed-layout compact events, the event id padded to 4
+/// bytes followed by the int32 browser id.
+const _kCompactEventHeaderSize = 8;
+
+final Map<String, int> _kEventIDs = {
+  for (final e in WebViewEvent.values) e.name: e.index,
+  _kEventAsyncChannelMessage: _kEventAsyncChannelMessageID,
+};
+
+/// When a script added with [WebViewController.addUserScript] runs.
+enum UserScriptInjectionTime {
+  /// When the V8 context of the document is created, before any script of
+  /// the page.
+  documentStart,
+
+  /// On the DOMContentLoaded event of the document.
+  domContentLoaded,
+}
+
+/// The frames a script added with [WebViewController.addUserScript] runs in.
+enum UserScriptFrames {
+  mainFrame,
+  allFrames,
+}
+
+/// How browser events are encoded on the event channel.
+enum WebViewEventEncoding {
+  /// `{type: name, value: value}` maps, the encoding of previous versions.
+  map,
+
+  /// Numeric event ids with fixed-layout byte payloads for scroll, cursor, IME
+  /// and progress events.
+  compact,
+}
+
+/// Events a [WebViewController] receives from the browser. Only events with a
+/// registered callback are sent by the native side, see
+/// [WebViewController.setEventRateLimit] for throttling them.
+///
+/// The order matches the native event ids, append new events at the end.
+enum WebViewEvent {
+  titleChanged,
+  urlChanged,
+  cursorChanged,
+  loadingProgressChanged,
+  scrollOffsetChanged,
+  loadingStateChanged,
+  loadStart,
+  loadEnd,
+  loadError,
+  imeComposionPositionChanged,
+  navigationStateChanged,
+  hostMessage,
+  resourceUsage,
+  renderProcessGone,
+}
+
+/// Why the render process of a browser went away, see
+/// [WebViewController.onRenderProcessGone].
+@immutable
+class RenderProcessGoneDetails {
+  /// `crashed`, `oom`, `killed`, `abnormalTermination`, `launchFailed`,
+  /// `integrityFailure` or `unknown`.
+  final String reason;
+  final int errorCode;
+  final String errorString;
+
+  /// When the page is reloaded, null if it is not, because recovery is off or
+  /// the renderer keeps crashing.
+  final Duration? recoveryDelay;
+
+  const RenderProcessGoneDetails({
+    required this.reason,
+    required this.errorCode,
+    required this.errorString,
+    this.recoveryDelay,
+  });
+
+  factory RenderProcessGoneDetails._fromMap(Map<dynamic, dynamic> m) {
+    final delay = m['recoveryDelay'] as int;
+    return RenderProcessGoneDetails(
+      reason: m['reason'] as String,
+      errorCode: m['errorCode'] as int,
+      errorString: m['errorString'] as String,
+      recoveryDelay: delay < 0 ? null : Duration(milliseconds: delay),
+    );
+  }
+}
+
 class WebViewController extends ChangeNotifier {
   static int _id = 0;
 
+  /// Live controllers by browser id, used to route the calls and events of
+  /// [_browsersChannel] and [_browsersEventChannel].
+  static final Map<int, WebViewController> _controllers = {};
+  static StreamSubscription? _browsersEventSubscription;
+
   final Completer<void> _creatingCompleter = Completer<void>();
   bool _isInitialized = false;
 
@@ -59,38 +176,215 @@ class WebViewController extends ChangeNotifier {
 
   Completer<int> _textureIdCompleter = Completer();
   bool _isDisposed = false;
-  late final MethodChannel _broswerChannel;
-  late final EventChannel _eventChannel;
-  StreamSubscription? _eventStreamSubscription;
 
   final ValueNotifier<CursorType> _cursorType = ValueNotifier(CursorType.pointer);
+  final ValueNotifier<NavigationState> _navigationState = ValueNotifier(const NavigationState());
+
+  /// The latest navigation state of the browser, kept in sync by the native
+  /// side so the navigation getters never wait on a platform call.
+  ValueListenable<NavigationState> get navigationState => _navigationState;
+
+  final ValueNotifier<bool> _discarded = ValueNotifier(false);
+
+  /// Whether the browser is discarded, see [discard]. The view keeps showing
+  /// the last frame meanwhile.
+  ValueListenable<bool> get discarded => _discarded;
 
   Future<void> get ready => _creatingCompleter.future;
 
-  TitleChangeCallback? onTitleChanged;
-  UrlChangeCallback? onUrlChanged;
-  ScrollOffsetChangedCallback? onScrollOffsetChanged;
+  TitleChangeCallback? _onTitleChanged;
+  TitleChangeCallback? get onTitleChanged => _onTitleChanged;
+  set onTitleChanged(TitleChangeCallback? cb) {
+    _onTitleChanged = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
+
+  UrlChangeCallback? _onUrlChanged;
+  UrlChangeCallback? get onUrlChanged => _onUrlChanged;
+  set onUrlChanged(UrlChangeCallback? cb) {
+    _onUrlChanged = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
+
+  ScrollOffsetChangedCallback? _onScrollOffsetChanged;
+  ScrollOffsetChangedCallback? get onScrollOffsetChanged => _onScrollOffsetChanged;
+  set onScrollOffsetChanged(ScrollOffsetChangedCallback? cb) {
+    _onScrollOffsetChanged = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
 
   /// Called when the overall page loading progress has changed.
   /// progress ranges from 0.0 to 1.0.
-  LoadingProgressChangedCallback? onLoadingProgressChanged;
+  LoadingProgressChangedCallback? _onLoadingProgressChanged;
+  LoadingProgressChangedCallback? get onLoadingProgressChanged => _onLoadingProgressChanged;
+  set onLoadingProgressChanged(LoadingProgressChangedCallback? cb) {
+    _onLoadingProgressChanged = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
 
   /// Called when the loading state has changed. This callback will be executed
   /// twice -- once when loading is initiated either programmatically or by user
   /// action, and once when loading is terminated due to completion, cancellation
   /// of failure. It will be called before any calls to OnLoadStart and after all
   /// calls to OnLoadError and/or OnLoadEnd.
-  LoadingStateChangedCallback? onLoadingStateChanged;
+  LoadingStateChangedCallback? _onLoadingStateChanged;
+  LoadingStateChangedCallback? get onLoadingStateChanged => _onLoadingStateChanged;
+  set onLoadingStateChanged(LoadingStateChangedCallback? cb) {
+    _onLoadingStateChanged = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
+
+  LoadStartCallback? _onLoadStart;
+  LoadStartCallback? get onLoadStart => _onLoadStart;
+  set onLoadStart(LoadStartCallback? cb) {
+    _onLoadStart = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
+
+  LoadEndCallback? _onLoadEnd;
+  LoadEndCallback? get onLoadEnd => _onLoadEnd;
+  set onLoadEnd(LoadEndCallback? cb) {
+    _onLoadEnd = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
 
-  LoadStartCallback? onLoadStart;
-  LoadEndCallback? onLoadEnd;
-  LoadErrorCallback? onLoadError;
+  LoadErrorCallback? _onLoadError;
+  LoadErrorCallback? get onLoadError => _onLoadError;
+  set onLoadError(LoadErrorCallback? cb) {
+    _onLoadError = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
+
+  /// Receives the values the page sends with `flutterHost.postMessage(value)`,
+  /// converted like the results of [evaluateJavaScript]. Unlike cefQuery the
+  /// messages are not answered, which makes them cheap enough for high rate
+  /// telemetry.
+  ///
+  /// Buffers the page transfers, `flutterHost.postMessage(buffer, [buffer])`,
+  /// and large buffers arrive as a [Uint8List] copied from the shared memory
+  /// of the renderer without any encoding. The list belongs to the callback,
+  /// nothing needs to be released. They use their own channel and may overtake the other
+  /// messages, and rate limits do not apply to them.
+  HostMessageCallback? _onHostMessage;
+  HostMessageCallback? get onHostMessage => _onHostMessage;
+  set onHostMessage(HostMessageCallback? cb) {
+    _onHostMessage = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
+
+  /// Receives the resource usage of the browser on every sample, see
+  /// [setResourceSamplingInterval].
+  ResourceUsageCallback? _onResourceUsage;
+  ResourceUsageCallback? get onResourceUsage => _onResourceUsage;
+  set onResourceUsage(ResourceUsageCallback? cb) {
+    _onResourceUsage = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
+
+  /// Called when the render process of the browser crashed or was killed.
+  /// Unless disabled with [setCrashRecovery] the page is reloaded on its last
+  /// committed URL with its scroll offset and zoom level, after a delay that
+  /// doubles with every crash in a row. The user scripts and registered
+  /// scripts are installed again, the page state and pending calls are lost.
+  RenderProcessGoneCallback? _onRenderProcessGone;
+  RenderProcessGoneCallback? get onRenderProcessGone => _onRenderProcessGone;
+  set onRenderProcessGone(RenderProcessGoneCallback? cb) {
+    _onRenderProcessGone = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
+
+  /// Called when a sample goes over a budget set with [setResourceBudget],
+  /// once until a sample is back under the budgets.
+  ResourceUsageCallback? onResourceBudgetExceeded;
+
+  /// Notified of the requests of the page, which are answered with an empty
+  /// string. Superseded by [cefQueryHandler].
   CefQueryCallback? onCefQuery;
 
+  /// Answers the requests of the page, see [CefQueryHandler].
+  CefQueryHandler? cefQueryHandler;
+
+  /// Open persistent queries by id.
+  final Map<int, CefQuery> _cefQueries = {};
+
+  final Map<WebViewEvent, int> _eventRateLimits = {};
+  bool _eventSubscriptionsUpdateScheduled = false;
+
+  /// Encoding of the browser events, [WebViewEventEncoding.map] is kept for
+  /// compatibility only.
+  final WebViewEventEncoding eventEncoding;
+
+  /// Request context of the browser, null for the global one. Browsers with a
+  /// context of their own are not taken from the pool, see
+  /// [setBrowserPoolSize].
+  final RequestContextSettings? requestContext;
+
   WebViewController({
     bool headless = false,
+    this.eventEncoding = WebViewEventEncoding.compact,
+    this.requestContext,
   }) : _headless = headless;
 
+  /// Starts CEF in the background with [GlobalCefSettings], ahead of the first
+  /// [initialize]. Completes once CEF is initialized, throws a [StateError] if
+  /// libcef.dll could not be loaded or CEF failed to initialize.
+  static Future<void> startCEF() => _startCEF();
+
+  /// The milestones of the CEF startup of the process reached so far, as the
+  /// time since the plugin library was loaded: `libraryLoaded`,
+  /// `startRequested`, `cefLibraryLoadStarted`, `cefLibraryLoaded`,
+  /// `cefInitializeStarted`, `cefInitializeFinished`, `contextInitialized`,
+  /// `firstBrowserCreated` and `firstPaint`. libcef.dll is only loaded when
+  /// CEF starts, between `cefLibraryLoadStarted` and `cefLibraryLoaded`.
+  static Future<Map<String, Duration>> getStartupTimeline() async {
+    final timeline = await _pluginChannel.invokeMapMethod<String, int>('getStartupTimeline') ?? {};
+    return timeline.map((name, us) => MapEntry(name, Duration(microseconds: us)));
+  }
+
+  /// Samples the memory and CPU usage of the browsers of this engine every
+  /// [interval], see [onResourceUsage] and [setResourceBudget]. Sampling is
+  /// cheap but not free, [Duration.zero], the default, stops it.
+  static Future<void> setResourceSamplingInterval(Duration interval) async {
+    assert(!interval.isNegative);
+    await _startCEF();
+    await _pluginChannel.invokeMethod('setResourceSamplingInterval', interval.inMilliseconds);
+  }
+
+  /// The tasks of the last sample, all the processes and workers of CEF and
+  /// not only those of the browsers. Empty if sampling is stopped.
+  static Future<List<TaskResourceUsage>> getResourceUsage() async {
+    final tasks = await _pluginChannel.invokeListMethod<Map<dynamic, dynamic>>('getResourceUsage') ?? [];
+    return tasks.map(TaskResourceUsage._fromMap).toList();
+  }
+
+  /// The resource usage of the last sample by process group, the name of the
+  /// request context of the browsers, see [RequestContextSettings.shared].
+  /// The '' group is the global context. A browser with an unnamed
+  /// [RequestContextSettings.ephemeral] context shares processes with no other
+  /// browser and is left out, see [getResourceUsage]. Empty if sampling is
+  /// stopped, see [setResourceSamplingInterval].
+  static Future<Map<String, ProcessGroupUsage>> getProcessGroupUsage() async {
+    final groups = await _pluginChannel.invokeMapMethod<String, Map<dynamic, dynamic>>('getProcessGroupUsage') ?? {};
+    return groups.map((name, m) => MapEntry(name, ProcessGroupUsage._fromMap(m)));
+  }
+
+  /// Keeps at most [limit] browsers of this engine alive, the least recently
+  /// used ones beyond it are discarded, see [discard]. Zero, the default, keeps
+  /// them all.
+  static Future<void> setLiveBrowserLimit(int limit) async {
+    assert(limit >= 0);
+    await _pluginChannel.invokeMethod('setLiveBrowserLimit', limit);
+  }
+
+  /// Keeps [size] idle browsers ready, so [initialize] hands one out instead of
+  /// waiting for a new browser and its renderer process. The pool fills in the
+  /// background once CEF is started and refills after every browser it hands
+  /// out. Zero, the default, disables it.
+  static Future<void> setBrowserPoolSize(int size) async {
+    assert(size >= 0);
+    await _pluginChannel.invokeMethod('setBrowserPoolSize', size);
+  }
+
   /// Initializes the underlying platform view.
   Future<void> initialize() async {
     assert(!_isDisposed);
@@ -98,22 +392,27 @@ class WebViewController extends ChangeNotifier {
     if (_isDisposed || _isInitialized) return;
     _isInitialized = true;
 
-    await _startCEF();
+    try {
+      await _startCEF();
+    } on StateError catch (e) {
+      _creatingCompleter.completeError(e);
+      return _creatingCompleter.future;
+    }
 
     try {
       _browserID = ++_id;
-      _broswerChannel = MethodChannel('webview_cef/$_browserID');
-      _broswerChannel.setMethodCallHandler(_methodCallhandler);
+      _controllers[_browserID] = this;
+      _listenBrowsers();
 
       final createBrowserArgs = {
         'browserID': _browserID,
         'headless': _headless,
         'dpi': PlatformDispatcher.instance.implicitView?.devicePixelRatio,
+        'eventEncoding': eventEncoding.name,
+        if (requestContext != null) 'requestContext': requestContext!._toMap(),
       };
       final textureId = await _pluginChannel.invokeMethod<int>('createBrowser', createBrowserArgs) ?? 0;
       if (textureId != 0) _textureIdCompleter.complete(textureId);
-      _eventChannel = EventChannel('webview_cef/$_browserID/events');
-      _eventStreamSubscription = _eventChannel.receiveBroadcastStream().listen(_handleBrowserEvents);
     } on PlatformException catch (e) {
       _creatingCompleter.completeError(e);
     }
@@ -127,7 +426,8 @@ class WebViewController extends ChangeNotifier {
 
     _headless = true;
     _textureIdCompleter = Completer();
-    await _broswerChannel.invokeMethod<int>('deattachView');
+    _scheduleEventSubscriptionsUpdate();
+    await _invokeBrowserMethod<int>('deattachView');
     notifyListeners();
   }
 
@@ -135,110 +435,361 @@ class WebViewController extends ChangeNotifier {
     assert(_headless);
 
     _headless = false;
-    _broswerChannel.invokeMethod<int>('attachView').then((tid) {
+    _scheduleEventSubscriptionsUpdate();
+    _invokeBrowserMethod<int>('attachView').then((tid) {
       _textureIdCompleter.complete(tid);
     });
     notifyListeners();
   }
 
   invalidate() async {
-    await _broswerChannel.invokeMethod<int>('invalidate');
+    await _invokeBrowserMethod<int>('invalidate');
+  }
+
+  static void _listenBrowsers() {
+    if (_browsersEventSubscription != null) return;
+
+    _browsersChannel.setMethodCallHandler(_handleBrowsersMethodCall);
+    ServicesBinding.instance.defaultBinaryMessenger.setMessageHandler(_kBrowsersPayloadChannel, _handlePayload);
+    _browsersEventSubscription = _browsersEventChannel.receiveBroadcastStream().listen(_handleBrowserEvents);
+  }
+
+  static Future<dynamic> _handleBrowsersMethodCall(MethodCall call) async {
+    final args = call.arguments as List<dynamic>;
+    return _controllers[args[0] as int]?._methodCallhandler(call.method, args[1]);
+  }
+
+  /// Header layout, ipc::SharedMessageHeader: uint8 type, 3 padding bytes,
+  /// int32 browser id, int32 async channel message id, uint32 payload size.
+  static Future<ByteData?> _handlePayload(ByteData? data) async {
+    if (data == null || data.lengthInBytes < _kPayloadHeaderSize) return null;
+
+    final messageID = data.getInt32(8, Endian.little);
+    final bytes = Uint8List.sublistView(data, _kPayloadHeaderSize);
+    switch (data.getUint8(0)) {
+      case _kPayloadTypeString:
+        _AsyncChannelMessageManager.completeWithResult(messageID, utf8.decode(bytes));
+        break;
+      case _kPayloadTypeBinary:
+        _AsyncChannelMessageManager.completeWithResult(messageID, bytes);
+        break;
+      case _kPayloadTypeHostMessage:
+        _controllers[data.getInt32(4, Endian.little)]?._onHostMessage?.call(bytes);
+        break;
+    }
+    return null;
+  }
+
+  static _handleBrowserEvents(dynamic event) {
+    if (event is Uint8List) {
+      final data = ByteData.sublistView(event);
+      _controllers[data.getInt32(4, Endian.little)]?._handleFixedLayoutEvent(data);
+    } else if (event is List) {
+      _dispatchEvent(event[1] as int, event[0] as int, event[2]);
+    } else {
+      final m = event as Map<dynamic, dynamic>;
+      _dispatchEvent(m['browserID'] as int, _kEventIDs[m['type']] ?? -1, m['value']);
+    }
   }
 
-  Future<dynamic> _methodCallhandler(MethodCall call) async {
-    switch (call.method) {
+  static _dispatchEvent(int browserID, int id, dynamic value) {
+    // Calls of a disposed controller still complete, with the error the
+    // native side fails them with.
+    if (id == _kEventAsyncChannelMessageID) {
+      _AsyncChannelMessageManager.handleChannelEvents(value);
+      return;
+    }
+    _controllers[browserID]?._dispatchBrowserEvent(id, value);
+  }
+
+  Future<dynamic> _methodCallhandler(String method, dynamic arguments) async {
+    switch (method) {
       case 'onBrowserCreated':
         _creatingCompleter.complete();
+        _updateEventSubscriptions();
+        return null;
+      case 'onBrowserDiscarded':
+        _discarded.value = true;
+        return null;
+      case 'onBrowserRestored':
+        _discarded.value = false;
+        return null;
+      case 'onResourceBudgetExceeded':
+        onResourceBudgetExceeded?.call(ResourceUsage._fromMap(arguments as Map<dynamic, dynamic>));
         return null;
       case 'onCefQuery':
-        onCefQuery?.call(request: call.arguments);
+        return _handleCefQuery(arguments as Map<dynamic, dynamic>);
+      case 'onCefQueryCanceled':
+        _cefQueries.remove(arguments as int)?._cancel();
         return null;
     }
 
     return null;
   }
 
-  _handleBrowserEvents(dynamic event) {
-    final m = event as Map<dynamic, dynamic>;
-    switch (m['type']) {
-      case _kEventURLChanged:
-        onUrlChanged?.call(m['value'] as String);
+  Future<String?> _handleCefQuery(Map<dynamic, dynamic> m) async {
+    final query = CefQuery._(this, m['queryID'] as int, m['request'] as String, m['persistent'] as bool);
+    final handler = cefQueryHandler;
+    if (handler == null) {
+      onCefQuery?.call(request: query.request);
+      return '';
+    }
+
+    if (query.persistent) _cefQueries[query.id] = query;
+    try {
+      return await handler(query);
+    } on CefQueryError catch (e) {
+      _cefQueries.remove(query.id);
+      throw PlatformException(code: 'CefQueryError', message: e.message, details: e.code);
+    } catch (_) {
+      _cefQueries.remove(query.id);
+      rethrow;
+    }
+  }
+
+  Future<T?> _invokeBrowserMethod<T>(String method, [dynamic arguments]) {
+    return _browsersChannel.invokeMethod<T>(method, [_browserID, arguments]);
+  }
+
+  _handleFixedLayoutEvent(ByteData data) {
+    const offset = _kCompactEventHeaderSize;
+    switch (WebViewEvent.values[data.getUint8(0)]) {
+      case WebViewEvent.cursorChanged:
+        _cursorType.value = CursorType.values[data.getInt32(offset, Endian.little)];
         return;
-      case _kEventTitleChanged:
-        onTitleChanged?.call(m['value'] as String);
+      case WebViewEvent.loadingProgressChanged:
+        _onLoadingProgressChanged?.call(data.getFloat64(offset, Endian.little));
         return;
-      case _kEventCursorChanged:
-        _cursorType.value = CursorType.values[m['value'] as int];
+      case WebViewEvent.scrollOffsetChanged:
+        _onScrollOffsetChanged?.call(
+          data.getFloat64(offset, Endian.little),
+          data.getFloat64(offset + 8, Endian.little),
+        );
         return;
-      case _kEventScrollOffsetChanged:
-        final offset = m['value'] as Map<dynamic, dynamic>;
-        onScrollOffsetChanged?.call(offset['x'] as double, offset['y'] as double);
+      case WebViewEvent.imeComposionPositionChanged:
+        _onIMEComposionPositionChangedCallback?.call(
+          data.getInt32(offset, Endian.little).toDouble(),
+          data.getInt32(offset + 4, Endian.little).toDouble(),
+        );
         return;
-      case _kEventLoadingProgressChanged:
-        onLoadingProgressChanged?.call(m['value'] as double);
+      default:
+    }
+  }
+
+  _dispatchBrowserEvent(int id, dynamic value) {
+    if (id < 0 || id >= WebViewEvent.values.length) return;
+
+    switch (WebViewEvent.values[id]) {
+      case WebViewEvent.urlChanged:
+        _onUrlChanged?.call(value as String);
+        return;
+      case WebViewEvent.titleChanged:
+        _onTitleChanged?.call(value as String);
+        return;
+      case WebViewEvent.cursorChanged:
+        _cursorType.value = CursorType.values[value as int];
         return;
-      case _kEventLoadingStateChanged:
-        onLoadingStateChanged?.call(m['value'] as bool);
+      case WebViewEvent.scrollOffsetChanged:
+        final offset = value as Map<dynamic, dynamic>;
+        _onScrollOffsetChanged?.call(offset['x'] as double, offset['y'] as double);
         return;
-      case _kEventLoadStart:
-        onLoadStart?.call(m['value'] as String);
+      case WebViewEvent.loadingProgressChanged:
+        _onLoadingProgressChanged?.call(value as double);
         return;
-      case _kEventLoadEnd:
-        onLoadEnd?.call(m['value'] as int);
+      case WebViewEvent.loadingStateChanged:
+        _onLoadingStateChanged?.call(value as bool);
         return;
-      case _kEventLoadError:
-        final data = m['value'] as Map<dynamic, dynamic>;
-        onLoadError?.call(
+      case WebViewEvent.loadStart:
+        _onLoadStart?.call(value as String);
+        return;
+      case WebViewEvent.loadEnd:
+        _onLoadEnd?.call(value as int);
+        return;
+      case WebViewEvent.loadError:
+        final data = value as Map<dynamic, dynamic>;
+        _onLoadError?.call(
           data['errorCode'] as int,
           data['errorText'] as String,
           data['failedUrl'] as String,
         );
         return;
-      case _kIMEComposionPositionChanged:
-        final pos = m['value'] as Map<dynamic, dynamic>;
-        _onIMEComposionPositionChanged?.call((pos['x'] as int).toDouble(), (pos['y'] as int).toDouble());
+      case WebViewEvent.imeComposionPositionChanged:
+        final pos = value as Map<dynamic, dynamic>;
+        _onIMEComposionPositionChangedCallback?.call((pos['x'] as int).toDouble(), (pos['y'] as int).toDouble());
+        return;
+      case WebViewEvent.navigationStateChanged:
+        _navigationState.value = NavigationState._fromList(value as List<dynamic>);
         return;
-      case _kEventAsyncChannelMessage:
-        _AsyncChannelMessageManager.handleChannelEvents(m['value']);
+      case WebViewEvent.hostMessage:
+        _onHostMessage?.call(value);
+        return;
+      case WebViewEvent.resourceUsage:
+        _onResourceUsage?.call(ResourceUsage._fromMap(value as Map<dynamic, dynamic>));
+        return;
+      case WebViewEvent.renderProcessGone:
+        _onRenderProcessGone?.call(RenderProcessGoneDetails._fromMap(value as Map<dynamic, dynamic>));
         return;
       default:
     }
   }
 
-  Function(double, double)? _onIMEComposionPositionChanged;
+  Function(double, double)? _onIMEComposionPositionChangedCallback;
+  Function(double, double)? get _onIMEComposionPositionChanged => _onIMEComposionPositionChangedCallback;
+  set _onIMEComposionPositionChanged(Function(double, double)? cb) {
+    _onIMEComposionPositionChangedCallback = cb;
+    _scheduleEventSubscriptionsUpdate();
+  }
+
+  /// Limits [event] to at most [maxPerSecond] deliveries, the latest value is
+  /// always delivered once the interval elapses. Pass null to remove the limit.
+  void setEventRateLimit(WebViewEvent event, int? maxPerSecond) {
+    assert(maxPerSecond == null || maxPerSecond > 0);
+    if (maxPerSecond == null) {
+      _eventRateLimits.remove(event);
+    } else {
+      _eventRateLimits[event] = maxPerSecond;
+    }
+    _scheduleEventSubscriptionsUpdate();
+  }
+
+  Set<WebViewEvent> get _subscribedEvents => {
+        WebViewEvent.navigationStateChanged,
+        if (!_headless) WebViewEvent.cursorChanged,
+        if (_onTitleChanged != null) WebViewEvent.titleChanged,
+        if (_onUrlChanged != null) WebViewEvent.urlChanged,
+        if (_onScrollOffsetChanged != null) WebViewEvent.scrollOffsetChanged,
+        if (_onLoadingProgressChanged != null) WebViewEvent.loadingProgressChanged,
+        if (_onLoadingStateChanged != null) WebViewEvent.loadingStateChanged,
+        if (_onLoadStart != null) WebViewEvent.loadStart,
+        if (_onLoadEnd != null) WebViewEvent.loadEnd,
+        if (_onLoadError != null) WebViewEvent.loadError,
+        if (_onIMEComposionPositionChangedCallback != null) WebViewEvent.imeComposionPositionChanged,
+        if (_onHostMessage != null) WebViewEvent.hostMessage,
+        if (_onResourceUsage != null) WebViewEvent.resourceUsage,
+        if (_onRenderProcessGone != null) WebViewEvent.renderProcessGone,
+      };
+
+  /// Batches callback changes made in the same frame into one native call.
+  void _scheduleEventSubscriptionsUpdate() {
+    if (_eventSubscriptionsUpdateScheduled) return;
+    _eventSubscriptionsUpdateScheduled = true;
+
+    scheduleMicrotask(() {
+      _eventSubscriptionsUpdateScheduled = false;
+      /// The initial subscriptions are sent once the browser is created.
+      if (_creatingCompleter.isCompleted) _updateEventSubscriptions();
+    });
+  }
+
+  Future<void> _updateEventSubscriptions() async {
+    if (_isDisposed) return;
+
+    final subscriptions = {
+      for (final e in _subscribedEvents) e.name: _eventRateLimits[e] ?? 0,
+    };
+    await _invokeBrowserMethod('setEventSubscriptions', subscriptions);
+  }
 
+  /// Closes the browser, completes once it is closed.
   @override
   Future<void> dispose() async {
     await _creatingCompleter.future;
     if (!_isDisposed) {
       _isDisposed = true;
-      await _broswerChannel.invokeMethod('dispose');
-      _eventStreamSubscription?.cancel();
-      _cursorType.dispose();
+      await _invokeBrowserMethod('dispose');
+      _releaseResources();
+    }
+    super.dispose();
+  }
+
+  /// Disposes the controller like [dispose] but hands its browser back to the
+  /// pool, see [setBrowserPoolSize]. The browser is reset to about:blank and
+  /// loses the user scripts, registered scripts and pending calls of this
+  /// controller. [clearStorage] clears the storage of the origin of the
+  /// current page. CEF cannot clear the navigation history, with
+  /// [clearHistory] the browser is closed and the pool creates a new one. The
+  /// browser is closed as well if the pool is full.
+  Future<void> release({bool clearHistory = false, bool clearStorage = false}) async {
+    await _creatingCompleter.future;
+    if (!_isDisposed) {
+      _isDisposed = true;
+      await _pluginChannel.invokeMethod('releaseBrowser', {
+        'browserID': _browserID,
+        'clearHistory': clearHistory,
+        'clearStorage': clearStorage,
+      });
+      _releaseResources();
     }
     super.dispose();
   }
 
+  void _releaseResources() {
+    _controllers.remove(_browserID);
+    for (final query in _cefQueries.values) {
+      query._cancel();
+    }
+    _cefQueries.clear();
+    _cursorType.dispose();
+    _navigationState.dispose();
+    _discarded.dispose();
+  }
+
+  /// Closes the browser and its renderer process to save memory, while the
+  /// controller and the view, which keeps the last frame, stay. The next call
+  /// on the controller creates a new browser on the current page and restores
+  /// the scroll offset, the calls wait for it. The back/forward history, the
+  /// page state and pending calls are lost.
+  Future<void> discard() async {
+    assert(!_isDisposed);
+    if (_isDisposed) return;
+
+    await _invokeBrowserMethod('discard');
+  }
+
+  /// Calls [onResourceBudgetExceeded] when the renderer process of the browser
+  /// uses more than [memory] bytes or more than [cpuUsage] percent CPU, 100
+  /// per fully used processor. Null removes a budget. Only checked while
+  /// sampling, see [setResourceSamplingInterval].
+  Future<void> setResourceBudget({int? memory, double? cpuUsage}) async {
+    assert(!_isDisposed);
+    if (_isDisposed) return;
+
+    await _invokeBrowserMethod('setResourceBudget', {
+      'memory': memory ?? 0,
+      'cpuUsage': cpuUsage ?? 0.0,
+    });
+  }
+
+  /// Whether the page is reloaded after its render process crashed, see
+  /// [onRenderProcessGone]. Enabled by default.
+  Future<void> setCrashRecovery(bool enabled) async {
+    assert(!_isDisposed);
+    if (_isDisposed) return;
+
+    await _invokeBrowserMethod('setCrashRecovery', enabled);
+  }
+
   /// Loads the given [url].
   Future<void> loadUrl(String url) async {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod('loadUrl', url);
+    return _invokeBrowserMethod('loadUrl', url);
   }
 
+  /// Returns the current url, answered from [navigationState].
   Future<String?> getUrl() async {
     assert(!_isDisposed);
     if (_isDisposed) return null;
 
-    return _broswerChannel.invokeMethod('getUrl');
+    return _navigationState.value.url;
   }
 
   Future<void> stopLoad() async {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod('stopLoad');
+    return _invokeBrowserMethod('stopLoad');
   }
 
   /// Reloads the current document.
@@ -246,72 +797,184 @@ class WebViewController extends ChangeNotifier {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod('reload');
+    return _invokeBrowserMethod('reload');
   }
 
+  /// Answered from [navigationState].
   Future<bool> canGoForward() async {
     assert(!_isDisposed);
     if (_isDisposed) return false;
 
-    return await _broswerChannel.invokeMethod('canGoForward');
+    return _navigationState.value.canGoForward;
   }
 
   Future<void> goForward() async {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod('goForward');
+    return _invokeBrowserMethod('goForward');
   }
 
+  /// Answered from [navigationState].
   Future<bool> canGoBack() async {
     assert(!_isDisposed);
     if (_isDisposed) return false;
 
-    return await _broswerChannel.invokeMethod('canGoBack');
+    return _navigationState.value.canGoBack;
   }
 
   Future<void> goBack() async {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod('goBack');
+    return _invokeBrowserMethod('goBack');
+  }
+
+  /// Evaluates [code] in the main frame and returns its completion value,
+  /// converted like `JSON.stringify` would except that ArrayBuffers and typed
+  /// arrays arrive as [Uint8List] and dates as ISO strings.
+  ///
+  /// Fails with a [TimeoutException] if no result arrived within [timeout],
+  /// see [cancelPendingEvaluations] for what happens to the script.
+  Future<dynamic> evaluateJavaScript(String code, [bool throwEvalError = false, Duration? timeout]) async {
+    assert(!_isDisposed);
+    if (_isDisposed) return;
+
+    final message = EvaluateJavaScriptMessage(code, throwEvalError: throwEvalError, timeout: timeout);
+    return _AsyncChannelMessageManager.invokeMethod(_invokeBrowserMethod, message);
+  }
+
+  /// Evaluates [scripts] in order with a single round trip to the renderer.
+  /// The results keep the order of [scripts], a failing script does not stop
+  /// the following ones. [timeout] applies to the whole batch.
+  Future<List<JavaScriptResult>> evaluateJavaScriptBatch(List<String> scripts, {Duration? timeout}) async {
+    assert(!_isDisposed);
+    if (_isDisposed) return [];
+    if (scripts.isEmpty) return [];
+
+    final message = EvaluateJavaScriptBatchMessage(scripts, timeout: timeout);
+    return _AsyncChannelMessageManager.invokeMethod(_invokeBrowserMethod, message);
+  }
+
+  /// Delivers [value] to the `flutterHost.onmessage` listener of the page as
+  /// a JavaScript value, [Uint8List]s become ArrayBuffers. No script is
+  /// compiled for it.
+  ///
+  /// Only a few messages are in flight to the page at a time. While the page
+  /// falls behind, a message with the [coalesceKey] of a message still waiting
+  /// replaces it, so only the latest value per key is delivered.
+  Future<void> postMessageToPage(Object? value, {String? coalesceKey}) async {
+    assert(!_isDisposed);
+    if (_isDisposed) return;
+
+    return _invokeBrowserMethod('postMessageToPage', {
+      'value': value,
+      if (coalesceKey != null) 'coalesceKey': coalesceKey,
+    });
+  }
+
+  /// Runs [source] in every document loaded from now on, at [injectionTime]
+  /// and in [frames]. The renderer keeps the script, so navigations cost no
+  /// extra messages. Returns the id to pass to [removeUserScript].
+  ///
+  /// A navigation to another site may move the page to a new render process.
+  /// Scripts the browser had when it was created reach that process before
+  /// its first page; scripts added later are sent when the process starts.
+  Future<int> addUserScript(
+    String source, {
+    UserScriptInjectionTime injectionTime = UserScriptInjectionTime.documentStart,
+    UserScriptFrames frames = UserScriptFrames.mainFrame,
+  }) async {
+    assert(!_isDisposed);
+    if (_isDisposed) throw StateError('WebViewController is disposed');
+
+    return (await _invokeBrowserMethod<int>('addUserScript', {
+      'source': source,
+      'injectionTime': injectionTime.index,
+      'allFrames': frames == UserScriptFrames.allFrames,
+    }))!;
+  }
+
+  /// Documents loaded from now on no longer run the script.
+  Future<void> removeUserScript(int id) async {
+    assert(!_isDisposed);
+    if (_isDisposed) return;
+
+    return _invokeBrowserMethod('removeUserScript', id);
+  }
+
+  /// Registers [source], a JavaScript function expression such as
+  /// `(a, b) => a + b`, and returns the handle to pass to [invokeScript].
+  /// The source is sent to the renderer once and compiled once per page.
+  Future<int> registerScript(String source) async {
+    assert(!_isDisposed);
+    if (_isDisposed) throw StateError('WebViewController is disposed');
+
+    return (await _invokeBrowserMethod<int>('registerScript', source))!;
+  }
+
+  Future<void> unregisterScript(int handle) async {
+    assert(!_isDisposed);
+    if (_isDisposed) return;
+
+    return _invokeBrowserMethod('unregisterScript', handle);
+  }
+
+  /// Calls the script registered as [handle] with [arguments] in the main
+  /// frame, only the handle and the arguments cross the process boundary.
+  /// The result is converted like the one of [evaluateJavaScript].
+  Future<dynamic> invokeScript(
+    int handle, [
+    List<dynamic> arguments = const [],
+    bool throwEvalError = false,
+    Duration? timeout,
+  ]) async {
+    assert(!_isDisposed);
+    if (_isDisposed) return;
+
+    final message = InvokeScriptMessage(handle, arguments, throwEvalError: throwEvalError, timeout: timeout);
+    return _AsyncChannelMessageManager.invokeMethod(_invokeBrowserMethod, message);
   }
 
-  Future<dynamic> evaluateJavaScript(String code, [bool throwEvalError = false]) async {
+  /// Fails every evaluation of this browser still waiting for its result.
+  ///
+  /// A running script cannot be interrupted, but once a call was canceled or
+  /// timed out the renderer is terminated if it stops responding, which fails
+  /// the remaining calls and lets the page reload.
+  Future<void> cancelPendingEvaluations() async {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    final message = EvaluateJavaScriptMessage(code, throwEvalError: throwEvalError);
-    return _AsyncChannelMessageManager.invokeMethod(_broswerChannel, message);
+    return _invokeBrowserMethod('cancelPendingCalls');
   }
 
   /// If true, allows "Ctrl + +/-" and "Ctrl + mouse wheel" to control page scaling
   bool allowShortcutZoom = false;
-  double _zoomLevel = 1.0;
+  /// Answered from [navigationState].
   Future<double?> getZoomLevel() async {
     assert(!_isDisposed);
     if (_isDisposed) return null;
 
-    final v = await _broswerChannel.invokeMethod<double>('getZoomLevel');
-    if (v != null) _zoomLevel = v;
-    return v;
+    return _navigationState.value.zoomLevel;
   }
 
   Future<void> setZoomLevel(double level) async {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    await _broswerChannel.invokeMethod('setZoomLevel', level);
-    _zoomLevel = level;
+    // Applied locally right away so repeated shortcuts accumulate, the native
+    // side confirms it with the next navigation state.
+    _navigationState.value = _navigationState.value._copyWith(zoomLevel: level);
+    await _invokeBrowserMethod('setZoomLevel', level);
   }
 
-  Future<void> _increaseZoomLevel(double dz) => setZoomLevel(_zoomLevel + dz);
+  Future<void> _increaseZoomLevel(double dz) => setZoomLevel(_navigationState.value.zoomLevel + dz);
 
   Future<void> openDevTools() async {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod('openDevTools');
+    return _invokeBrowserMethod('openDevTools');
   }
 
   /// Prints current page as PDF file.
@@ -330,7 +993,7 @@ class WebViewController extends ChangeNotifier {
    assert(!_isDisposed);
     if (_isDisposed) return false;
 
-    return (await _broswerChannel.invokeMethod<bool>('printToPDF', {
+    return (await _invokeBrowserMethod<bool>('printToPDF', {
       'path': filepath,
       'pageWidth': pageWidth,
       'pageHeight': pageHeight,
@@ -342,14 +1005,14 @@ class WebViewController extends ChangeNotifier {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod('focus');
+    return _invokeBrowserMethod('focus');
   }
 
   Future<void> _unfocus() async {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod('unfocus');
+    return _invokeBrowserMethod('unfocus');
   }
 
   /// Moves the virtual cursor to [position].
@@ -357,32 +1020,28 @@ class WebViewController extends ChangeNotifier {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel
-        .invokeMethod('cursorMove', [position.dx.round(), position.dy.round()]);
+    return _invokeBrowserMethod('cursorMove', [position.dx.round(), position.dy.round()]);
   }
 
   Future<void> _cursorDragging(Offset position) async {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod(
-        'cursorDragging', [position.dx.round(), position.dy.round()]);
+    return _invokeBrowserMethod('cursorDragging', [position.dx.round(), position.dy.round()]);
   }
 
   Future<void> _cursorClickDown(Offset position) async {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod(
-        'cursorClickDown', [position.dx.round(), position.dy.round()]);
+    return _invokeBrowserMethod('cursorClickDown', [position.dx.round(), position.dy.round()]);
   }
 
   Future<void> _cursorClickUp(Offset position) async {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod(
-        'cursorClickUp', [position.dx.round(), position.dy.round()]);
+    return _invokeBrowserMethod('cursorClickUp', [position.dx.round(), position.dy.round()]);
   }
 
   /// Sets the horizontal and vertical scroll delta.
@@ -390,8 +1049,7 @@ class WebViewController extends ChangeNotifier {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel.invokeMethod(
-        'setScrollDelta', [position.dx.round(), position.dy.round(), dx, dy]);
+    return _invokeBrowserMethod('setScrollDelta', [position.dx.round(), position.dy.round(), dx, dy]);
   }
 
   /// Sets the surface size to the provided [size].
@@ -399,7 +1057,6 @@ class WebViewController extends ChangeNotifier {
     assert(!_isDisposed);
     if (_isDisposed) return;
 
-    return _broswerChannel
-        .invokeMethod('setSize', [dpi, size.width, size.height, viewOffset.dx, viewOffset.dy]);
+    return _invokeBrowserMethod('setSize', [dpi, size.width, size.height, viewOffset.dx, viewOffset.dy]);
   }
 }
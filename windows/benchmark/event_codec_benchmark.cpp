@@ -0,0 +1,81 @@
+// Measures the per event cost of the map and compact event encodings, from
+// building the event to the bytes written by the EventSink, and back.
+
+#include <flutter/standard_method_codec.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "event_codec.h"
+
+using event_codec::EventEncoding;
+using event_codec::EventType;
+
+namespace {
+
+constexpr int kIterations = 200000;
+constexpr int32_t kBrowserID = 42;
+
+struct Sample {
+    const char* name;
+    std::function<flutter::EncodableValue(EventEncoding)> encode;
+};
+
+double NanosecondsPerIteration(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double, std::nano>(d).count() / kIterations;
+}
+
+void Run(const Sample& sample, EventEncoding encoding) {
+    const auto& codec = flutter::StandardMethodCodec::GetInstance();
+    const auto& message_codec = flutter::StandardMessageCodec::GetInstance();
+
+    size_t encoded_size = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; i++) {
+        const auto event = sample.encode(encoding);
+        encoded_size += codec.EncodeSuccessEnvelope(&event)->size();
+    }
+    const auto encode_time = std::chrono::steady_clock::now() - start;
+
+    // The success envelope is a zero byte followed by the encoded event.
+    const auto event = sample.encode(encoding);
+    const auto envelope = codec.EncodeSuccessEnvelope(&event);
+    size_t decoded = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; i++) {
+        const auto value = message_codec.DecodeMessage(envelope->data() + 1, envelope->size() - 1);
+        if (value && event_codec::DecodeEvent(*value)) decoded++;
+    }
+    const auto decode_time = std::chrono::steady_clock::now() - start;
+
+    std::printf("%-28s %-8s %8zu %12.1f %12.1f\n",
+                sample.name,
+                encoding == EventEncoding::Map ? "map" : "compact",
+                encoded_size / kIterations,
+                NanosecondsPerIteration(encode_time),
+                decoded == kIterations ? NanosecondsPerIteration(decode_time) : -1.0);
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<Sample> samples = {
+        {"scrollOffsetChanged", [](EventEncoding e) { return event_codec::EncodeScrollOffsetChanged(e, kBrowserID, 120.5, 4096.25); }},
+        {"cursorChanged", [](EventEncoding e) { return event_codec::EncodeCursorChanged(e, kBrowserID, 3); }},
+        {"imeComposionPositionChanged", [](EventEncoding e) { return event_codec::EncodeIMEComposionPositionChanged(e, kBrowserID, 320, 48); }},
+        {"loadingProgressChanged", [](EventEncoding e) { return event_codec::EncodeLoadingProgressChanged(e, kBrowserID, 0.75); }},
+        {"urlChanged", [](EventEncoding e) {
+            return event_codec::EncodeEvent(e, kBrowserID, EventType::URLChanged, flutter::EncodableValue("https://example.com/"));
+        }},
+    };
+
+    std::printf("%-28s %-8s %8s %12s %12s\n", "event", "codec", "bytes", "encode ns", "decode ns");
+    for (const auto& sample : samples) {
+        Run(sample, EventEncoding::Map);
+        Run(sample, EventEncoding::Compact);
+    }
+    return 0;
+}
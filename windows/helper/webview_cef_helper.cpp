@@ -0,0 +1,27 @@
+// Entry point of the Chromium child processes. It only links CEF and the
+// renderer side of the plugin, so the renderer, GPU and utility processes no
+// longer start the Flutter runner and load the engine before
+// CefExecuteProcess returns.
+
+#include <windows.h>
+
+#include "include/cef_app.h"
+#include "include/cef_command_line.h"
+
+#include "client_app.h"
+#include "renderer/client_app_renderer.h"
+
+int APIENTRY wWinMain(_In_ HINSTANCE instance, _In_opt_ HINSTANCE prev,
+                      _In_ wchar_t* command_line, _In_ int show_command) {
+	CefMainArgs main_args(instance);
+
+	CefRefPtr<CefCommandLine> cef_command_line = CefCommandLine::CreateCommandLine();
+	cef_command_line->InitFromString(::GetCommandLineW());
+
+	CefRefPtr<CefApp> app = nullptr;
+	if (ClientApp::GetProcessType(cef_command_line) == ClientApp::RendererProcess) {
+		app = new ClientAppRenderer();
+	}
+
+	return CefExecuteProcess(main_args, app, nullptr);
+}
@@ -19,6 +19,21 @@ FLUTTER_PLUGIN_EXPORT void WebviewCefPluginCApiRegisterWithRegistrar(
 
 FLUTTER_PLUGIN_EXPORT int InitCEFProcesses();
 
+// Starts CEF in the background with the default settings, so the Chromium
+// startup overlaps with the startup of the Flutter engine instead of delaying
+// the first WebViewController. Call it from wWinMain after InitCEFProcesses,
+// the CefSettings passed from Dart are ignored then.
+FLUTTER_PLUGIN_EXPORT void StartCEF();
+
+// Closes all browsers at once, then quits and joins the CEF thread. Call it
+// when the Flutter window is destroyed, before the FlutterViewController is
+// released; CEF cannot be started again afterwards. Browsers that take longer than |timeout_ms| to close are
+// left to CefShutdown, and the CEF thread is abandoned if it is still running
+// when the time is up, so the exit stays within the budget. It is abandoned
+// right away if CEF is still initializing. Returns the teardown time in
+// milliseconds.
+FLUTTER_PLUGIN_EXPORT int ShutdownCEF(int timeout_ms);
+
 FLUTTER_PLUGIN_EXPORT void ProcessMessageForCEF(unsigned int message, unsigned __int64 wParam, __int64 lParam);
 
 void processKeyEventForCEF(unsigned int message, unsigned __int64 wParam, __int64 lParam);
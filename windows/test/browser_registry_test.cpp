@@ -0,0 +1,122 @@
+// Checks that a command sent through the registry leaves the browser
+// registered and holding no more references than before, and that a browser
+// whose engine goes away no longer reaches it. The handlers have no browser,
+// so nothing calls into libcef.
+
+#include <flutter/binary_messenger.h>
+#include <flutter/method_result_functions.h>
+#include <flutter/standard_method_codec.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "browser/browser_registry.h"
+#include "browser/webview_handler.h"
+#include "test_util.h"
+
+namespace {
+
+const char kMethodChannelName[] = "webview_cef/browsers";
+
+class MockBinaryMessenger : public flutter::BinaryMessenger {
+public:
+    void Send(const std::string& channel, const uint8_t* message, size_t message_size,
+              flutter::BinaryReply reply) const override {
+        sent++;
+    }
+
+    void SetMessageHandler(const std::string& channel, flutter::BinaryMessageHandler handler) override {
+        if (handler) {
+            handlers[channel] = std::move(handler);
+        } else {
+            handlers.erase(channel);
+        }
+    }
+
+    std::map<std::string, flutter::BinaryMessageHandler> handlers;
+    mutable int sent = 0;
+};
+
+// Calls |method| on the browser channel the way the Dart side does and
+// returns whether it succeeded.
+bool CallMethod(MockBinaryMessenger& messenger, const std::string& method, int browser_id,
+                flutter::EncodableValue arguments) {
+    const auto& codec = flutter::StandardMethodCodec::GetInstance();
+    const auto message = codec.EncodeMethodCall(flutter::MethodCall<flutter::EncodableValue>(
+        method, std::make_unique<flutter::EncodableValue>(flutter::EncodableList{
+            flutter::EncodableValue(browser_id),
+            std::move(arguments),
+        })));
+
+    bool succeeded = false;
+    messenger.handlers.at(kMethodChannelName)(message->data(), message->size(),
+        [&](const uint8_t* reply, size_t reply_size) {
+            flutter::MethodResultFunctions<flutter::EncodableValue> result(
+                [&](const flutter::EncodableValue*) { succeeded = true; }, nullptr, nullptr);
+            codec.DecodeAndProcessResponseEnvelope(reply, reply_size, &result);
+        });
+    return succeeded;
+}
+
+}  // namespace
+
+using test_util::Expect;
+using test_util::Finish;
+using test_util::MockTextureRegistrar;
+
+int main() {
+    MockBinaryMessenger messenger;
+    {
+        BrowserRegistry registry(&messenger);
+        CefRefPtr<WebviewHandler> handler =
+            new WebviewHandler(&registry, nullptr, 1, 1.0f, event_codec::EventEncoding::Map);
+        Expect(registry.Add(1, handler), "browser is registered");
+
+        Expect(CallMethod(messenger, "setEventSubscriptions", 1, flutter::EncodableValue(flutter::EncodableMap{})),
+               "command succeeds");
+        Expect(registry.Find(1) == handler, "browser stays registered after a command");
+
+        WebviewHandler* raw = handler.get();
+        handler = nullptr;
+        Expect(raw->HasOneRef(), "command leaves only the registry reference");
+
+        registry.Remove(1);
+        Expect(!registry.Find(1), "browser is removed");
+    }
+    Expect(messenger.handlers.empty(), "registry clears its handlers");
+
+    // The engine of a browser goes away while the browser lives on.
+    CefRefPtr<WebviewHandler> orphan;
+    {
+        MockTextureRegistrar textures(1);
+        auto registry = std::make_unique<BrowserRegistry>(&messenger);
+        orphan = new WebviewHandler(registry.get(), &textures, 2, 1.0f, event_codec::EventEncoding::Map);
+        registry->Add(2, orphan);
+
+        Expect(CallMethod(messenger, "setResourceBudget", 2, flutter::EncodableValue(flutter::EncodableMap{
+                   {flutter::EncodableValue("memory"), flutter::EncodableValue(int64_t(1))},
+               })),
+               "budget is set");
+        const auto texture_id = orphan->AttachView();
+        Expect(textures.registered.count(texture_id) == 1, "view registers a texture with its engine");
+
+        const int sent = messenger.sent;
+        orphan->OnResourceUsage(2, 0);
+        Expect(messenger.sent == sent + 1, "exceeded budget is reported to the engine");
+
+        orphan->DetachFromEngine();
+        Expect(textures.registered.empty(), "detaching unregisters the texture");
+
+        orphan->OnResourceUsage(1, 0);
+        orphan->OnResourceUsage(2, 0);
+        Expect(messenger.sent == sent + 1, "detached browser reports nothing to its engine");
+        Expect(orphan->AttachView() == 0, "detached browser registers no texture");
+    }
+    // Neither the registry nor the registrar exists any more.
+    orphan->OnResourceUsage(1, 0);
+    orphan->OnResourceUsage(2, 0);
+    orphan->DeattachView();
+
+    return Finish("browser_registry_test");
+}
@@ -0,0 +1,69 @@
+#ifndef WINDOWS_TEST_TEST_UTIL_H_
+#define WINDOWS_TEST_TEST_UTIL_H_
+#pragma once
+
+// The checks and mocks of the native tests. Each test is a plain executable
+// run by CTest, a failed check is printed and fails the executable.
+
+#include <flutter/texture_registrar.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <set>
+#include <vector>
+
+namespace test_util {
+
+inline int failures = 0;
+
+inline void Expect(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// The exit code of the test |name|.
+inline int Finish(const char* name) {
+    if (failures) return EXIT_FAILURE;
+    std::printf("%s passed\n", name);
+    return EXIT_SUCCESS;
+}
+
+// Hands out texture ids from |first_id| on and records the frames marked
+// available, distinct ranges tell engines apart.
+class MockTextureRegistrar : public flutter::TextureRegistrar {
+public:
+    explicit MockTextureRegistrar(int64_t first_id) : next_id_(first_id) {}
+
+    int64_t RegisterTexture(flutter::TextureVariant* texture) override {
+        registered.insert(next_id_);
+        return next_id_++;
+    }
+
+    bool MarkTextureFrameAvailable(int64_t texture_id) override {
+        if (!registered.count(texture_id)) return false;
+        frames.push_back(texture_id);
+        return true;
+    }
+
+    void UnregisterTexture(int64_t texture_id, std::function<void()> callback) override {
+        UnregisterTexture(texture_id);
+        if (callback) callback();
+    }
+
+    bool UnregisterTexture(int64_t texture_id) override {
+        return registered.erase(texture_id) > 0;
+    }
+
+    std::set<int64_t> registered;
+    std::vector<int64_t> frames;
+
+private:
+    int64_t next_id_;
+};
+
+}  // namespace test_util
+
+#endif  // WINDOWS_TEST_TEST_UTIL_H_
@@ -0,0 +1,49 @@
+// Checks that browsers created from two engines each paint into the texture
+// registrar of their own engine.
+
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "test_util.h"
+#include "texture_handler.h"
+
+using test_util::Expect;
+using test_util::Finish;
+using test_util::MockTextureRegistrar;
+
+int main() {
+    // Distinct id ranges make a texture registered with the wrong engine
+    // visible.
+    MockTextureRegistrar first(1);
+    MockTextureRegistrar second(1000);
+
+    const std::vector<uint32_t> pixels(4 * 4, 0xff0000ff);
+    {
+        auto a = std::make_unique<TextureHandler>(&first);
+        auto b = std::make_unique<TextureHandler>(&second);
+        auto c = std::make_unique<TextureHandler>(&first);
+
+        Expect(first.registered == std::set<int64_t>{a->texture_id(), c->texture_id()},
+               "first engine owns the textures created from it");
+        Expect(second.registered == std::set<int64_t>{b->texture_id()},
+               "second engine owns the texture created from it");
+
+        a->onPaintCallback(pixels.data(), 4, 4);
+        b->onPaintCallback(pixels.data(), 4, 4);
+        b->onPaintCallback(pixels.data(), 4, 4);
+        c->onPaintCallback(pixels.data(), 4, 4);
+
+        Expect(first.frames == std::vector<int64_t>{a->texture_id(), c->texture_id()},
+               "frames of the first engine browsers reach the first registrar");
+        Expect(second.frames == std::vector<int64_t>{b->texture_id(), b->texture_id()},
+               "frames of the second engine browser reach the second registrar");
+
+        b.reset();
+        Expect(second.registered.empty(), "closing a browser unregisters from its own engine");
+        Expect(first.registered.size() == 2, "closing a browser leaves the other engine alone");
+    }
+    Expect(first.registered.empty(), "all textures of the first engine are unregistered");
+
+    return Finish("texture_handler_test");
+}
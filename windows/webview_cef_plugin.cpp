@@ -3,11 +3,24 @@
 #include <flutter/method_channel.h>
 #include <flutter/plugin_registrar_windows.h>
 #include <flutter/standard_method_codec.h>
+#include <delayimp.h>
 
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <memory>
+#include <optional>
+#include <string>
 #include <thread>
 
+#include "include/base/cef_callback.h"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#include "browser/browser_registry.h"
+#include "browser/request_contexts.h"
 #include "browser/webview_app.h"
+#include "startup_timeline.h"
 #include "texture_handler.h"
 
 #define ColorUNDERLINE \
@@ -18,24 +31,146 @@
               // same as Blink.
 
 namespace webview_cef {
-	bool init = false;
+	std::atomic<bool> init = false;
 
 	bool composingText = false;
 
-	flutter::BinaryMessenger* messenger;
-
 	CefRefPtr<WebviewApp> app;
 	CefMainArgs mainArgs;
 
-	void startCEF(CefSettings cefs) {
+	// Runs the CEF message loop, joined by ShutdownCEF. Left running, and
+	// leaked, if the application exits without it.
+	std::thread* cef_thread = nullptr;
+	std::promise<void> cef_thread_exited;
+
+	// Returns the path of webview_cef_helper.exe if it is bundled next to the
+	// application executable, an empty string otherwise.
+	std::wstring GetHelperPath() {
+		wchar_t path[MAX_PATH];
+		const auto length = ::GetModuleFileNameW(nullptr, path, MAX_PATH);
+		if (length == 0 || length == MAX_PATH) return std::wstring();
+
+		std::wstring helper_path(path, length);
+		helper_path.resize(helper_path.find_last_of(L"\\/") + 1);
+		helper_path += L"webview_cef_helper.exe";
+		if (::GetFileAttributesW(helper_path.c_str()) == INVALID_FILE_ATTRIBUTES) return std::wstring();
+		return helper_path;
+	}
+
+	// The settings Dart passes to startCEF. They only become CefSettings on
+	// the CEF thread, CefString calls into libcef.dll which is not loaded yet.
+	struct StartSettings {
+		std::optional<std::string> cache_path;
+		std::optional<std::string> root_cache_path;
+		std::optional<std::string> subprocess_path;
+		int renderer_process_limit = 0;
+		bool process_per_site = false;
+		bool relaxed_site_isolation = false;
+	};
+
+	void startCEF(StartSettings start_settings) {
+		// Resolves all the delay-loaded imports at once, so the load time is
+		// measured here rather than spread over the first CEF calls.
+		startup_timeline::Record(startup_timeline::Milestone::CefLibraryLoadStarted);
+		if (FAILED(__HrLoadAllImportsForDll("libcef.dll"))) {
+			// Nothing of CEF ran, the next startCEF tries again.
+			cef_thread_exited.set_value();
+			init = false;
+			app->OnStartFailed(false);
+			return;
+		}
+		startup_timeline::Record(startup_timeline::Milestone::CefLibraryLoaded);
+
 		CefWindowInfo window_info;
 		CefBrowserSettings settings;
 		window_info.SetAsWindowless(nullptr);
 
+		CefSettings cefs;
+		if (start_settings.cache_path) CefString(&cefs.cache_path) = *start_settings.cache_path;
+		if (start_settings.root_cache_path) CefString(&cefs.root_cache_path) = *start_settings.root_cache_path;
 		cefs.windowless_rendering_enabled = true;
-		CefInitialize(mainArgs, cefs, app.get(), nullptr);
+		// Child processes start the small helper instead of the application,
+		// which would load the Flutter engine first.
+		if (start_settings.subprocess_path) {
+			CefString(&cefs.browser_subprocess_path) = *start_settings.subprocess_path;
+		} else {
+			const auto helper_path = GetHelperPath();
+			if (!helper_path.empty()) CefString(&cefs.browser_subprocess_path) = helper_path;
+		}
+		startup_timeline::Record(startup_timeline::Milestone::CefInitializeStarted);
+		const bool initialized = CefInitialize(mainArgs, cefs, app.get(), nullptr);
+		startup_timeline::Record(startup_timeline::Milestone::CefInitializeFinished);
+		if (!initialized) {
+			cef_thread_exited.set_value();
+			app->OnStartFailed(true);
+			return;
+		}
 		CefRunMessageLoop();
+		request_contexts::Clear();
 		CefShutdown();
+		cef_thread_exited.set_value();
+	}
+
+	CefRefPtr<WebviewApp> GetApp() {
+		if (!app) {
+			app = new WebviewApp();
+		}
+		return app;
+	}
+
+	// Settings of calls after the first one are ignored.
+	void StartCEFThread(const StartSettings& start_settings) {
+		if (init.exchange(true)) return;
+
+		// Left by a start that could not load libcef.dll.
+		if (cef_thread) {
+			cef_thread->join();
+			delete cef_thread;
+			cef_thread_exited = std::promise<void>();
+		}
+
+		startup_timeline::Record(startup_timeline::Milestone::StartRequested);
+		GetApp()->SetProcessModel(start_settings.renderer_process_limit, start_settings.process_per_site,
+			start_settings.relaxed_site_isolation);
+		cef_thread = new std::thread([start_settings](){
+			startCEF(start_settings);
+		});
+	}
+
+	void StartCEF() {
+		StartCEFThread(StartSettings());
+	}
+
+	int ShutdownCEF(int timeout_ms) {
+		static std::atomic<bool> shut_down = false;
+		if (!init || shut_down.exchange(true)) return 0;
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto deadline = start + std::chrono::milliseconds(timeout_ms);
+		const auto elapsed = [start]() {
+			return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - start).count());
+		};
+		// The thread is already gone if CEF failed to start.
+		auto exited = cef_thread_exited.get_future();
+		if (exited.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			// Closing is only waited for, CefShutdown runs with the browsers
+			// that are still open once the time is up.
+			WebviewApp::CloseAllBrowsers(deadline);
+			// Fails while CefInitialize is still running, the message loop
+			// would then never be told to quit and waiting is pointless.
+			if (!CefPostTask(TID_UI, base::BindOnce(&CefQuitMessageLoop))) {
+				cef_thread->detach();
+				return elapsed();
+			}
+		}
+
+		if (exited.wait_until(deadline) == std::future_status::ready) {
+			cef_thread->join();
+		} else {
+			cef_thread->detach();
+		}
+		return elapsed();
 	}
 
 	template <typename T>
@@ -50,62 +185,104 @@ namespace webview_cef {
 		return std::nullopt;
 	}
 
-	CefSettings GetCefSettings(const flutter::MethodCall<flutter::EncodableValue>& method_call) {
+	StartSettings GetStartSettings(const flutter::MethodCall<flutter::EncodableValue>& method_call) {
 		const flutter::EncodableMap* map = std::get_if<flutter::EncodableMap>(method_call.arguments());
-		CefSettings settings;
+		StartSettings settings;
 		if (!map) return settings;
 
-		const auto cache_path = GetOptionalValue<std::string>(*map, "cachePath");
-		if (cache_path) CefString(&settings.cache_path) = cache_path.value();
+		settings.cache_path = GetOptionalValue<std::string>(*map, "cachePath");
+		settings.root_cache_path = GetOptionalValue<std::string>(*map, "rootCachePath");
+		settings.subprocess_path = GetOptionalValue<std::string>(*map, "subprocessPath");
+		settings.renderer_process_limit = GetOptionalValue<int>(*map, "rendererProcessLimit").value_or(0);
+		settings.process_per_site = GetOptionalValue<bool>(*map, "processPerSite").value_or(false);
+		settings.relaxed_site_isolation = GetOptionalValue<bool>(*map, "relaxedSiteIsolation").value_or(false);
+		return settings;
+	}
 
-		const auto root_cache_path = GetOptionalValue<std::string>(*map, "rootCachePath");
-		if (root_cache_path) CefString(&settings.root_cache_path) = root_cache_path.value();
+	// The requestContext argument of createBrowser, nullopt for the global
+	// context.
+	std::optional<request_contexts::Options> GetRequestContextOptions(const flutter::EncodableMap& map) {
+		const auto context = GetOptionalValue<flutter::EncodableMap>(map, "requestContext");
+		if (!context) return std::nullopt;
 
-		return settings;
+		request_contexts::Options options;
+		options.name = GetOptionalValue<std::string>(*context, "name").value_or("");
+		options.cache_path = GetOptionalValue<std::string>(*context, "cachePath").value_or("");
+		return options;
 	}
 
 	// static
 	void WebviewCefPlugin::RegisterWithRegistrar(
 		flutter::PluginRegistrarWindows* registrar) {
-		TextureHandler::InitTextureRegistrar(registrar->texture_registrar());
-		messenger = registrar->messenger();
+		// Every engine registers its own plugin instance, they all share the
+		// one CEF runtime of the process.
+		GetApp();
+
 		auto plugin_channel =
 			std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
-				messenger, "webview_cef", &flutter::StandardMethodCodec::GetInstance());
+				registrar->messenger(), "webview_cef", &flutter::StandardMethodCodec::GetInstance());
 
-		auto plugin = std::make_unique<WebviewCefPlugin>();
-		plugin_channel->SetMethodCallHandler(
-			[plugin_pointer = plugin.get()](const auto& call, auto result) {
-				plugin_pointer->HandleMethodCall(call, std::move(result));
-			});
-		app = new WebviewApp(std::move(plugin_channel));
+		auto plugin = std::make_unique<WebviewCefPlugin>(
+			registrar->messenger(), registrar->texture_registrar(), std::move(plugin_channel));
 		registrar->AddPlugin(std::move(plugin));
 	}
 
 	void WebviewCefPlugin::sendKeyEvent(CefKeyEvent ev)
 	{
-		auto broswer = WebviewHandler::CurrentFocusedBrowser();
+		auto broswer = BrowserRegistry::FocusedBrowser();
 		if (broswer) {
 			broswer->GetHost()->SendKeyEvent(ev);
 		}
 	}
 
-	WebviewCefPlugin::WebviewCefPlugin() {}
+	WebviewCefPlugin::WebviewCefPlugin(
+		flutter::BinaryMessenger* messenger,
+		flutter::TextureRegistrar* texture_registrar,
+		std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> plugin_channel)
+		: browsers_(std::make_unique<BrowserRegistry>(messenger)),
+		  texture_registrar_(texture_registrar),
+		  browser_pool_(std::make_unique<BrowserPool>(browsers_.get(), texture_registrar, app)),
+		  resource_sampler_(new ResourceSampler(browsers_.get())),
+		  plugin_channel_(std::move(plugin_channel)) {
+		plugin_channel_->SetMethodCallHandler(
+			[this](const auto& call, auto result) {
+				HandleMethodCall(call, std::move(result));
+			});
+	}
+
+	WebviewCefPlugin::~WebviewCefPlugin() {
+		if (context_initialized_callback_id_) {
+			app->RemoveContextInitializedCallback(context_initialized_callback_id_);
+		}
+		// Waits for a sample in progress on the UI thread, which still uses
+		// the registry of this engine.
+		resource_sampler_->Stop();
+		plugin_channel_->SetMethodCallHandler(nullptr);
 
-	WebviewCefPlugin::~WebviewCefPlugin() {}
+		// Browsers outlive their engine unless they are cut off from it here,
+		// they would keep painting into and calling into freed objects.
+		for (auto& handler : browsers_->Browsers()) {
+			handler->DetachFromEngine();
+		}
+		browser_pool_.reset();
+	}
 
 	void WebviewCefPlugin::HandleMethodCall(
 		const flutter::MethodCall<flutter::EncodableValue>& method_call,
 		std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
 		if (method_call.method_name().compare("startCEF") == 0) {
-			if (!init) {
-				auto cefSettings = GetCefSettings(method_call);
-				new std::thread([cefSettings](){
-					startCEF(cefSettings);
-				});
-				init = true;
-			}
+			// Settings of engines starting CEF after the first one, or after
+			// StartCEF, are ignored.
+			StartCEFThread(GetStartSettings(method_call));
 			result->Success();
+			// Registered again so that a call after a failed start gets an
+			// answer too.
+			if (context_initialized_callback_id_) {
+				app->RemoveContextInitializedCallback(context_initialized_callback_id_);
+			}
+			context_initialized_callback_id_ = app->AddContextInitializedCallback([this](bool initialized) {
+				plugin_channel_->InvokeMethod(initialized ? "onCEFInitialized" : "onCEFStartFailed", nullptr);
+			});
 		} else if (method_call.method_name().compare("createBrowser") == 0) {
 			const flutter::EncodableMap* map = std::get_if<flutter::EncodableMap>(method_call.arguments());
 			if (!map) {
@@ -121,16 +298,89 @@ namespace webview_cef {
 
 			const auto headless = GetOptionalValue<bool>(*map, "headless").value_or(false);
 			const auto dpi = GetOptionalValue<double>(*map, "dpi").value_or(1);
-			auto handler = new WebviewHandler(messenger, *browser_id, (float)dpi);
-			app->CreateBrowser(handler);
+			const auto event_encoding = event_codec::EventEncodingFromName(
+				GetOptionalValue<std::string>(*map, "eventEncoding").value_or("map"));
+			if (!event_encoding) {
+				result->Error("InvalidArguments", "eventEncoding");
+				return;
+			}
+
+			// A pooled browser already exists, it answers onBrowserCreated at
+			// once. Pooled browsers use the global context.
+			const auto request_context = GetRequestContextOptions(*map);
+			CefRefPtr<WebviewHandler> handler;
+			if (!request_context) handler = browser_pool_->Lease(*browser_id, (float)dpi, *event_encoding);
+			if (!handler) {
+				handler = new WebviewHandler(browsers_.get(), texture_registrar_, *browser_id, (float)dpi, *event_encoding);
+				if (request_context) {
+					handler->SetRequestContext(request_contexts::Get(*request_context), request_context->name);
+				}
+				if (!browsers_->Add(*browser_id, handler)) {
+					result->Error("InvalidArguments", "browserID");
+					return;
+				}
+				app->CreateBrowser(handler);
+			}
 			if (headless) {
 				result->Success();
 			} else {
 				auto const texture_id = handler->AttachView();
 				result->Success(flutter::EncodableValue(texture_id));
 			}
+		} else if (method_call.method_name().compare("releaseBrowser") == 0) {
+			const flutter::EncodableMap* map = std::get_if<flutter::EncodableMap>(method_call.arguments());
+			if (!map) {
+				result->Error("NoArguments");
+				return;
+			}
+
+			const auto browser_id = GetOptionalValue<int>(*map, "browserID");
+			CefRefPtr<WebviewHandler> handler;
+			if (browser_id) handler = browsers_->Find(*browser_id);
+			if (!handler) {
+				result->Error("InvalidArguments", "browserID");
+				return;
+			}
+
+			browser_pool_->Return(handler,
+				GetOptionalValue<bool>(*map, "clearHistory").value_or(false),
+				GetOptionalValue<bool>(*map, "clearStorage").value_or(false));
+			result->Success();
+		} else if (method_call.method_name().compare("setBrowserPoolSize") == 0) {
+			const auto size = std::get_if<int>(method_call.arguments());
+			if (!size || *size < 0) {
+				result->Error("InvalidArguments", "size");
+				return;
+			}
+
+			browser_pool_->SetSize(static_cast<size_t>(*size));
+			result->Success();
+		} else if (method_call.method_name().compare("setLiveBrowserLimit") == 0) {
+			const auto limit = std::get_if<int>(method_call.arguments());
+			if (!limit || *limit < 0) {
+				result->Error("InvalidArguments", "limit");
+				return;
+			}
+
+			browsers_->SetLiveBrowserLimit(static_cast<size_t>(*limit));
+			result->Success();
+		} else if (method_call.method_name().compare("setResourceSamplingInterval") == 0) {
+			const auto interval = std::get_if<int>(method_call.arguments());
+			if (!interval || *interval < 0) {
+				result->Error("InvalidArguments", "interval");
+				return;
+			}
+
+			resource_sampler_->SetInterval(*interval);
+			result->Success();
+		} else if (method_call.method_name().compare("getResourceUsage") == 0) {
+			result->Success(flutter::EncodableValue(resource_sampler_->GetSnapshot()));
+		} else if (method_call.method_name().compare("getProcessGroupUsage") == 0) {
+			result->Success(flutter::EncodableValue(resource_sampler_->GetGroupSnapshot()));
+		} else if (method_call.method_name().compare("getStartupTimeline") == 0) {
+			result->Success(flutter::EncodableValue(startup_timeline::ToEncodableMap()));
 		} else if (method_call.method_name().compare("imeSetComposition") == 0) {
-			auto browser = WebviewHandler::CurrentFocusedBrowser();
+			auto browser = BrowserRegistry::FocusedBrowser();
 			if (browser) {
 				const auto text = *std::get_if<std::string>(method_call.arguments());
 				CefString cTextStr = CefString(text);
@@ -152,7 +402,7 @@ namespace webview_cef {
 			}
 			result->Success();
 		} else if (method_call.method_name().compare("imeCommitText") == 0) {
-			auto browser = WebviewHandler::CurrentFocusedBrowser();
+			auto browser = BrowserRegistry::FocusedBrowser();
 			if (browser) {
 				const auto text = *std::get_if<std::string>(method_call.arguments());
 				CefString cTextStr = CefString(text);
@@ -164,13 +414,13 @@ namespace webview_cef {
 			}
 			result->Success();
 		} else if (method_call.method_name().compare("imeFinishComposingText") == 0) {
-			auto browser = WebviewHandler::CurrentFocusedBrowser();
+			auto browser = BrowserRegistry::FocusedBrowser();
 			if (browser) {
 				browser->GetHost()->ImeFinishComposingText(false);
 			}
 			result->Success();
 		} else if (method_call.method_name().compare("imeCancelComposition") == 0) {
-			auto browser = WebviewHandler::CurrentFocusedBrowser();
+			auto browser = BrowserRegistry::FocusedBrowser();
 			if (browser) {
 				browser->GetHost()->ImeCancelComposition();
 			}
@@ -7,16 +7,29 @@
 #include <memory>
 
 #include "include/cef_app.h"
+#include "browser/browser_pool.h"
+#include "browser/browser_registry.h"
+#include "browser/resource_sampler.h"
 
 namespace webview_cef {
 extern bool composingText;
 
+// Starts CEF on its own thread with the default settings, unless it is
+// already started.
+void StartCEF();
+
+// Closes every browser, stops the CEF thread and waits for it, within
+// |timeout_ms| overall. Returns the time it took in milliseconds.
+int ShutdownCEF(int timeout_ms);
+
 class WebviewCefPlugin : public flutter::Plugin {
 public:
     static void RegisterWithRegistrar(flutter::PluginRegistrarWindows *registrar);
     static void sendKeyEvent(CefKeyEvent ev);
 
-    WebviewCefPlugin();
+    WebviewCefPlugin(flutter::BinaryMessenger* messenger,
+                     flutter::TextureRegistrar* texture_registrar,
+                     std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> plugin_channel);
 
     virtual ~WebviewCefPlugin();
 
@@ -29,6 +42,18 @@ public:
     void HandleMethodCall(
         const flutter::MethodCall<flutter::EncodableValue> &method_call,
         std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+    // The engine this plugin instance was registered with, browsers created
+    // through it talk to Dart through its registry and paint into its
+    // texture registrar.
+    std::unique_ptr<BrowserRegistry> browsers_;
+    flutter::TextureRegistrar* texture_registrar_;
+    // Destroyed before the registry its idle browsers point to.
+    std::unique_ptr<BrowserPool> browser_pool_;
+    // Stopped before the registry it samples is destroyed.
+    CefRefPtr<ResourceSampler> resource_sampler_;
+    std::unique_ptr<flutter::MethodChannel<flutter::EncodableValue>> plugin_channel_;
+    int context_initialized_callback_id_ = 0;
 };
 
 }  // namespace webview_cef
@@ -1,8 +1,10 @@
 ﻿#include "include/webview_cef/webview_cef_plugin_c_api.h"
 
 #include <flutter/plugin_registrar_windows.h>
+#include <shellapi.h>
+
+#include <string>
 
-#include "client_app.h"
 #include "renderer/client_app_renderer.h"
 #include "webview_cef_plugin.h"
 #include "include/cef_app.h"
@@ -98,25 +100,50 @@ int GetCefKeyboardModifiers(WPARAM wparam, LPARAM lparam) {
 	return modifiers;
 }
 
+// Returns the value of the --type switch Chromium passes to its child
+// processes, an empty string in the browser process. The command line is
+// parsed without CEF, so the browser process does not load libcef.dll before
+// CEF is started.
+std::wstring GetProcessTypeSwitch() {
+	const std::wstring prefix = L"--type=";
+	int argc = 0;
+	LPWSTR* argv = ::CommandLineToArgvW(::GetCommandLineW(), &argc);
+	if (!argv) return std::wstring();
+
+	std::wstring process_type;
+	for (int i = 1; i < argc; i++) {
+		const std::wstring arg = argv[i];
+		if (arg.compare(0, prefix.size(), prefix) == 0) {
+			process_type = arg.substr(prefix.size());
+			break;
+		}
+	}
+	::LocalFree(argv);
+	return process_type;
+}
+
 FLUTTER_PLUGIN_EXPORT int InitCEFProcesses() {
-	CefRefPtr<CefCommandLine> command_line = CefCommandLine::CreateCommandLine();
-	auto args = ::GetCommandLineW();
-	command_line->InitFromString(args);
+	// The browser process, like CefExecuteProcess would answer.
+	const auto process_type = GetProcessTypeSwitch();
+	if (process_type.empty()) return -1;
 
-	// command_line->AppendSwitch("enable-logging");
-	// command_line->AppendSwitchWithValue("v", "1");
 	CefMainArgs mainArgs;
 	CefRefPtr<CefApp> app = nullptr;
-	ClientApp::ProcessType process_type = ClientApp::GetProcessType(command_line);
-	if (process_type == ClientApp::BrowserProcess) {
-		// app = new ClientAppBrowser();
-	} else if (process_type == ClientApp::RendererProcess) {
+	if (process_type == L"renderer") {
 		app = new ClientAppRenderer();
 	}
 
 	return CefExecuteProcess(mainArgs, app, nullptr);
 }
 
+FLUTTER_PLUGIN_EXPORT void StartCEF() {
+	webview_cef::StartCEF();
+}
+
+FLUTTER_PLUGIN_EXPORT int ShutdownCEF(int timeout_ms) {
+	return webview_cef::ShutdownCEF(timeout_ms);
+}
+
 FLUTTER_PLUGIN_EXPORT void ProcessMessageForCEF(unsigned int message, unsigned __int64 wParam, __int64 lParam) {
 	switch (message) {
     case WM_IME_SETCONTEXT: